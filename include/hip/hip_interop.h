@@ -23,6 +23,19 @@
 #ifndef HIP_INTEROP_H
 #define HIP_INTEROP_H
 
+/*
+ * Stream creation flag extension for hipStreamCreateWithFlags() and
+ * hipStreamCreateWithPriority(). hipStreamEngineAffinity(Index) places the
+ * stream on the hardware queue 'Index' (0-254, modulo the number of queues)
+ * of its engine group instead of the least loaded one and keeps it there.
+ * Backends without hardware queue selection ignore it.
+ */
+#define hipStreamEngineAffinityShift 16
+#define hipStreamEngineAffinityMask (0xffu << hipStreamEngineAffinityShift)
+#define hipStreamEngineAffinity(Index)                                         \
+  ((((unsigned)(Index) + 1u) << hipStreamEngineAffinityShift) &                \
+   hipStreamEngineAffinityMask)
+
 #ifdef __cplusplus
 #include <cstdint>
 extern "C" {
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2023 CHIP-SPV developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+
+// Measures the latency of host callbacks: the time from enqueuing a host
+// function on an idle stream until it runs, and the round trip until the
+// stream resumes after it.
+//
+// Usage: callbackLatencyBench [iterations]
+
+#include "hip/hip_runtime.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+using Clock = std::chrono::steady_clock;
+
+static std::atomic<Clock::rep> CallbackTime;
+
+static void recordTime(void *) {
+  CallbackTime = Clock::now().time_since_epoch().count();
+}
+
+static void streamCallback(hipStream_t, hipError_t, void *UserData) {
+  recordTime(UserData);
+}
+
+__global__ void emptyKernel() {}
+
+template <typename EnqueueFn>
+static void measure(const char *Name, hipStream_t Stream, int Iters,
+                    EnqueueFn Enqueue) {
+  double ToCallbackUs = 0, RoundTripUs = 0;
+  for (int i = 0; i < Iters; i++) {
+    CallbackTime = 0;
+    auto Start = Clock::now();
+    Enqueue(Stream);
+    CHECK(hipStreamSynchronize(Stream));
+    auto End = Clock::now();
+
+    auto Called = Clock::time_point(Clock::duration(CallbackTime.load()));
+    ToCallbackUs +=
+        std::chrono::duration<double, std::micro>(Called - Start).count();
+    RoundTripUs +=
+        std::chrono::duration<double, std::micro>(End - Start).count();
+  }
+  printf("%-24s %16.3f %16.3f\n", Name, ToCallbackUs / Iters,
+         RoundTripUs / Iters);
+}
+
+int main(int argc, char *argv[]) {
+  int Iters = argc > 1 ? atoi(argv[1]) : 1000;
+
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+  // Warm-up.
+  CHECK(hipLaunchHostFunc(Stream, recordTime, nullptr));
+  CHECK(hipStreamSynchronize(Stream));
+
+  printf("%-24s %16s %16s\n", "Operation", "us/to-callback", "us/round-trip");
+  measure("hipStreamAddCallback", Stream, Iters, [](hipStream_t S) {
+    CHECK(hipStreamAddCallback(S, streamCallback, nullptr, 0));
+  });
+  measure("hipLaunchHostFunc", Stream, Iters, [](hipStream_t S) {
+    CHECK(hipLaunchHostFunc(S, recordTime, nullptr));
+  });
+  // The kernel after the host function waits for it to complete.
+  measure("hipLaunchHostFunc+kernel", Stream, Iters, [](hipStream_t S) {
+    CHECK(hipLaunchHostFunc(S, recordTime, nullptr));
+    hipLaunchKernelGGL(emptyKernel, dim3(1), dim3(1), 0, S);
+  });
+
+  CHECK(hipStreamDestroy(Stream));
+  return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2023 CHIP-SPV developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Measures the bandwidth of large hipMemcpyAsync transfers. The Level Zero
+// backend stripes copies across copy engines according to
+// CHIP_L0_COPY_ENGINES and CHIP_L0_COPY_CHUNK_SIZE, so run this once per
+// configuration to compare them, e.g.:
+//
+//   CHIP_L0_COPY_ENGINES=1 copyStripeBench
+//   CHIP_L0_COPY_ENGINES=4 CHIP_L0_COPY_CHUNK_SIZE=8388608 copyStripeBench
+//
+// Usage: copyStripeBench [max-size-MiB] [iterations]
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+static double measure(void *Dst, const void *Src, size_t Size, int Iters,
+                      hipMemcpyKind Kind, hipStream_t Stream) {
+  // Warm-up: creates the copy queues.
+  CHECK(hipMemcpyAsync(Dst, Src, Size, Kind, Stream));
+  CHECK(hipStreamSynchronize(Stream));
+
+  auto Start = std::chrono::steady_clock::now();
+  for (int i = 0; i < Iters; i++)
+    CHECK(hipMemcpyAsync(Dst, Src, Size, Kind, Stream));
+  CHECK(hipStreamSynchronize(Stream));
+  auto End = std::chrono::steady_clock::now();
+
+  double Seconds = std::chrono::duration<double>(End - Start).count();
+  return double(Size) * Iters / Seconds / 1e9;
+}
+
+static const char *envOr(const char *Name, const char *Default) {
+  const char *Value = getenv(Name);
+  return Value ? Value : Default;
+}
+
+int main(int argc, char *argv[]) {
+  size_t MaxSize = size_t(argc > 1 ? atoi(argv[1]) : 1024) << 20;
+  int Iters = argc > 2 ? atoi(argv[2]) : 10;
+
+  char *Host, *DevA, *DevB;
+  CHECK(hipHostMalloc((void **)&Host, MaxSize));
+  CHECK(hipMalloc((void **)&DevA, MaxSize));
+  CHECK(hipMalloc((void **)&DevB, MaxSize));
+  for (size_t i = 0; i < MaxSize; i++)
+    Host[i] = char(i * 7);
+  hipStream_t Stream;
+  CHECK(hipStreamCreate(&Stream));
+
+  printf("CHIP_L0_COPY_ENGINES=%s CHIP_L0_COPY_CHUNK_SIZE=%s\n",
+         envOr("CHIP_L0_COPY_ENGINES", "(default)"),
+         envOr("CHIP_L0_COPY_CHUNK_SIZE", "(default)"));
+  printf("%-12s %12s %12s %12s\n", "Size (MiB)", "H2D GB/s", "D2H GB/s",
+         "D2D GB/s");
+  for (size_t Size = 1 << 20; Size <= MaxSize; Size *= 4) {
+    double H2D = measure(DevA, Host, Size, Iters, hipMemcpyHostToDevice,
+                         Stream);
+    double D2H = measure(Host, DevA, Size, Iters, hipMemcpyDeviceToHost,
+                         Stream);
+    double D2D = measure(DevB, DevA, Size, Iters, hipMemcpyDeviceToDevice,
+                         Stream);
+    printf("%-12zu %12.2f %12.2f %12.2f\n", Size >> 20, H2D, D2H, D2D);
+  }
+
+  // The chunks must land where they belong.
+  CHECK(hipMemcpy(DevA, Host, MaxSize, hipMemcpyHostToDevice));
+  CHECK(hipMemcpy(DevB, DevA, MaxSize, hipMemcpyDeviceToDevice));
+  char *Check = (char *)malloc(MaxSize);
+  CHECK(hipMemcpy(Check, DevB, MaxSize, hipMemcpyDeviceToHost));
+  if (memcmp(Check, Host, MaxSize)) {
+    fprintf(stderr, "error: copied data mismatch\n");
+    return 1;
+  }
+
+  free(Check);
+  CHECK(hipStreamDestroy(Stream));
+  CHECK(hipFree(DevB));
+  CHECK(hipFree(DevA));
+  CHECK(hipHostFree(Host));
+  return 0;
+}
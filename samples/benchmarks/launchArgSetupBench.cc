@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2023 CHIP-SPV developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Measures the host-side cost of hipLaunchKernel as the kernel argument
+// count grows. The kernels do (almost) no work so the time per launch is
+// dominated by argument setup and submission.
+//
+// Usage: launchArgSetupBench [iterations]
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+template <typename... Ts> __global__ void argKernel(int *Out, Ts... Args) {
+  if (threadIdx.x == 0 && blockIdx.x == 0)
+    *Out = (0 + ... + Args);
+}
+
+// A by-value aggregate large enough to be passed via the argument spill
+// buffer.
+struct BigArg {
+  int Data[512];
+};
+
+__global__ void bigArgKernel(int *Out, BigArg A) {
+  if (threadIdx.x == 0 && blockIdx.x == 0)
+    *Out = A.Data[0] + A.Data[511];
+}
+
+template <size_t I> using IntArg = int;
+
+template <size_t... Is>
+static double timeLaunches(int *Out, int Iters, std::index_sequence<Is...>) {
+  auto *Kernel = argKernel<IntArg<Is>...>;
+  // Warm-up: triggers lazy JIT and first-launch allocations.
+  hipLaunchKernelGGL(Kernel, dim3(1), dim3(1), 0, 0, Out, int(Is)...);
+  CHECK(hipDeviceSynchronize());
+
+  auto Start = std::chrono::steady_clock::now();
+  for (int i = 0; i < Iters; i++)
+    hipLaunchKernelGGL(Kernel, dim3(1), dim3(1), 0, 0, Out, int(Is)...);
+  auto End = std::chrono::steady_clock::now();
+  CHECK(hipDeviceSynchronize());
+
+  return std::chrono::duration<double, std::micro>(End - Start).count() /
+         Iters;
+}
+
+static double timeBigArgLaunches(int *Out, int Iters) {
+  BigArg A = {};
+  hipLaunchKernelGGL(bigArgKernel, dim3(1), dim3(1), 0, 0, Out, A);
+  CHECK(hipDeviceSynchronize());
+
+  auto Start = std::chrono::steady_clock::now();
+  for (int i = 0; i < Iters; i++)
+    hipLaunchKernelGGL(bigArgKernel, dim3(1), dim3(1), 0, 0, Out, A);
+  auto End = std::chrono::steady_clock::now();
+  CHECK(hipDeviceSynchronize());
+
+  return std::chrono::duration<double, std::micro>(End - Start).count() /
+         Iters;
+}
+
+int main(int argc, char *argv[]) {
+  int Iters = argc > 1 ? atoi(argv[1]) : 10000;
+
+  int *Out;
+  CHECK(hipMalloc((void **)&Out, sizeof(int)));
+
+  printf("%-12s %16s\n", "NumArgs", "us/launch");
+  printf("%-12d %16.3f\n", 1 + 1,
+         timeLaunches(Out, Iters, std::make_index_sequence<1>()));
+  printf("%-12d %16.3f\n", 1 + 4,
+         timeLaunches(Out, Iters, std::make_index_sequence<4>()));
+  printf("%-12d %16.3f\n", 1 + 16,
+         timeLaunches(Out, Iters, std::make_index_sequence<16>()));
+  printf("%-12d %16.3f\n", 1 + 64,
+         timeLaunches(Out, Iters, std::make_index_sequence<64>()));
+  printf("%-12s %16.3f\n", "spilled",
+         timeBigArgLaunches(Out, Iters));
+
+  CHECK(hipFree(Out));
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023 CHIP-SPV developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Measures submission throughput when several host threads launch the
+// same kernel or enqueue small copies, each on its own stream. Ideally the
+// aggregate rate grows with the thread count as the threads do not share
+// a submission lock.
+//
+// Usage: launchScalingBench [max threads] [launches per thread]
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+__global__ void addKernel(int *Out, int A, int B) {
+  if (threadIdx.x == 0 && blockIdx.x == 0)
+    *Out = A + B;
+}
+
+template <typename SubmitFn>
+static double submissionsPerSecond(unsigned NumThreads, int Iters,
+                                   SubmitFn Submit) {
+  std::vector<std::thread> Threads;
+  auto Start = std::chrono::steady_clock::now();
+  for (unsigned t = 0; t < NumThreads; t++)
+    Threads.emplace_back([&, t]() {
+      for (int i = 0; i < Iters; i++)
+        Submit(t, i);
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+  auto End = std::chrono::steady_clock::now();
+  CHECK(hipDeviceSynchronize());
+
+  double Seconds = std::chrono::duration<double>(End - Start).count();
+  return NumThreads * Iters / Seconds;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned MaxThreads = argc > 1 ? atoi(argv[1]) : 8;
+  int Iters = argc > 2 ? atoi(argv[2]) : 10000;
+
+  std::vector<hipStream_t> Streams(MaxThreads);
+  std::vector<int *> Outs(MaxThreads);
+  for (unsigned t = 0; t < MaxThreads; t++) {
+    CHECK(hipStreamCreate(&Streams[t]));
+    CHECK(hipMalloc((void **)&Outs[t], 2 * sizeof(int)));
+    // Warm-up: triggers lazy JIT and the per-stream first-launch setup.
+    hipLaunchKernelGGL(addKernel, dim3(1), dim3(1), 0, Streams[t], Outs[t], 0,
+                       0);
+    CHECK(hipMemcpyAsync(Outs[t] + 1, Outs[t], sizeof(int),
+                         hipMemcpyDeviceToDevice, Streams[t]));
+  }
+  CHECK(hipDeviceSynchronize());
+
+  auto Launch = [&](unsigned t, int i) {
+    hipLaunchKernelGGL(addKernel, dim3(1), dim3(1), 0, Streams[t], Outs[t], i,
+                       int(t));
+  };
+  auto Copy = [&](unsigned t, int i) {
+    CHECK(hipMemcpyAsync(Outs[t] + 1, Outs[t], sizeof(int),
+                         hipMemcpyDeviceToDevice, Streams[t]));
+  };
+
+  printf("%-12s %16s %16s\n", "Threads", "launches/s", "copies/s");
+  for (unsigned NumThreads = 1; NumThreads <= MaxThreads; NumThreads *= 2)
+    printf("%-12u %16.0f %16.0f\n", NumThreads,
+           submissionsPerSecond(NumThreads, Iters, Launch),
+           submissionsPerSecond(NumThreads, Iters, Copy));
+
+  for (unsigned t = 0; t < MaxThreads; t++) {
+    CHECK(hipFree(Outs[t]));
+    CHECK(hipStreamDestroy(Streams[t]));
+  }
+  return 0;
+}
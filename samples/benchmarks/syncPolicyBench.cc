@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2023 CHIP-SPV developers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Compares the synchronization policies selected with hipSetDeviceFlags():
+// the wall time of waiting for a short and a longer kernel and the CPU time
+// the process spends while waiting.
+//
+// Usage: syncPolicyBench [iterations] [kernel-loop-count]
+
+#include "hip/hip_runtime.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#define CHECK(cmd)                                                             \
+  {                                                                            \
+    hipError_t error = cmd;                                                    \
+    if (error != hipSuccess) {                                                 \
+      fprintf(stderr, "error: '%s'(%d) at %s:%d\n", hipGetErrorString(error),  \
+              error, __FILE__, __LINE__);                                      \
+      exit(1);                                                                 \
+    }                                                                          \
+  }
+
+__global__ void busyKernel(int *Out, int LoopCount) {
+  int V = threadIdx.x;
+  for (int i = 0; i < LoopCount; i++)
+    V = V * 1664525 + 1013904223;
+  if (V == 42)
+    *Out = V;
+}
+
+template <typename SyncFn>
+static void measure(const char *Policy, const char *SyncName, int *Out,
+                    int Iters, int LoopCount, hipEvent_t Event, SyncFn Sync) {
+  // Warm-up.
+  hipLaunchKernelGGL(busyKernel, dim3(1), dim3(64), 0, 0, Out, LoopCount);
+  Sync(Event);
+
+  double WallUs = 0;
+  std::clock_t CpuStart = std::clock();
+  for (int i = 0; i < Iters; i++) {
+    hipLaunchKernelGGL(busyKernel, dim3(1), dim3(64), 0, 0, Out, LoopCount);
+    CHECK(hipEventRecord(Event, 0));
+    auto Start = std::chrono::steady_clock::now();
+    Sync(Event);
+    auto End = std::chrono::steady_clock::now();
+    WallUs += std::chrono::duration<double, std::micro>(End - Start).count();
+  }
+  double CpuUs = 1e6 * double(std::clock() - CpuStart) / CLOCKS_PER_SEC;
+
+  printf("%-14s %-12s %10d %14.3f %10.1f\n", Policy, SyncName, LoopCount,
+         WallUs / Iters, 100.0 * CpuUs / WallUs);
+}
+
+int main(int argc, char *argv[]) {
+  int Iters = argc > 1 ? atoi(argv[1]) : 1000;
+  int LongLoopCount = argc > 2 ? atoi(argv[2]) : 1000000;
+
+  int *Out;
+  CHECK(hipMalloc((void **)&Out, sizeof(int)));
+  hipEvent_t Event;
+  CHECK(hipEventCreateWithFlags(&Event, hipEventDisableTiming));
+
+  struct {
+    const char *Name;
+    unsigned Flag;
+  } Policies[] = {{"auto", hipDeviceScheduleAuto},
+                  {"spin", hipDeviceScheduleSpin},
+                  {"yield", hipDeviceScheduleYield},
+                  {"blocking", hipDeviceScheduleBlockingSync}};
+
+  auto StreamSync = [](hipEvent_t) { CHECK(hipStreamSynchronize(0)); };
+  auto EventSync = [](hipEvent_t E) { CHECK(hipEventSynchronize(E)); };
+
+  // The CPU column is the process CPU time relative to the time spent
+  // waiting. It includes the runtime's helper threads.
+  printf("%-14s %-12s %10s %14s %10s\n", "Policy", "Sync", "LoopCount",
+         "us/sync", "CPU %");
+  for (auto &P : Policies) {
+    CHECK(hipSetDeviceFlags(P.Flag));
+    for (int LoopCount : {1, LongLoopCount}) {
+      measure(P.Name, "stream", Out, Iters, LoopCount, Event, StreamSync);
+      measure(P.Name, "event", Out, Iters, LoopCount, Event, EventSync);
+    }
+  }
+
+  CHECK(hipEventDestroy(Event));
+  CHECK(hipFree(Out));
+  return 0;
+}
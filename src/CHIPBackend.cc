@@ -35,7 +35,6 @@ static void queueKernel(CHIPQueue *Q, CHIPKernel *K, void *Args[] = nullptr,
   EI->setKernel(K);
 
   EI->copyArgs(Args);
-  EI->setupAllArgs();
 
   auto ChipQueue = EI->getQueue();
   if (!ChipQueue)
@@ -199,38 +198,44 @@ CHIPAllocationTracker::getAllocInfoCheckPtrRanges(void *DevPtr) {
 // ************************************************************************
 
 CHIPEvent::CHIPEvent(CHIPContext *Ctx, CHIPEventFlags Flags)
-    : EventStatus_(EVENT_STATUS_INIT), Flags_(Flags), Refc_(new size_t()),
-      ChipContext_(Ctx), Msg("") {}
+    : EventStatus_(EVENT_STATUS_INIT), Flags_(Flags), ChipContext_(Ctx),
+      Msg("") {}
 
 void CHIPEvent::releaseDependencies() {
-  for (auto Event : DependsOnList) {
-    Event->decreaseRefCount("An event that depended on this one has finished");
+  std::vector<CHIPEvent *> Dependencies;
+  {
+    LOCK(EventMtx); // CHIPEvent::DependsOnList
+    Dependencies.swap(DependsOnList);
   }
-  LOCK(EventMtx); // CHIPEvent::DependsOnList
-  DependsOnList.clear();
+  for (auto *Event : Dependencies)
+    Event->decreaseRefCount("An event that depended on this one has finished");
 }
 
-void CHIPEvent::decreaseRefCount(std::string Reason) {
-  LOCK(EventMtx); // CHIPEvent::Refc_
-  // logDebug("CHIPEvent::decreaseRefCount() {} {} refc {}->{} REASON: {}",
-  //          (void *)this, Msg.c_str(), *Refc_, *Refc_ - 1, Reason);
-  if (*Refc_ > 0) {
-    (*Refc_)--;
-  } else {
-    logError("CHIPEvent::decreaseRefCount() called when refc == 0");
-  }
-  // Destructor to be called by event monitor once backend is done using it
-}
-void CHIPEvent::increaseRefCount(std::string Reason) {
-  LOCK(EventMtx); // CHIPEvent::Refc_
-  // logDebug("CHIPEvent::increaseRefCount() {} {} refc {}->{} REASON: {}",
-  //          (void *)this, Msg.c_str(), *Refc_, *Refc_ + 1, Reason);
-  (*Refc_)++;
+void CHIPEvent::decreaseRefCount(const char *Reason) {
+  size_t Refc = Refc_.load(std::memory_order_relaxed);
+  do {
+    if (Refc == 0) {
+      logError("CHIPEvent::decreaseRefCount() called when refc == 0");
+      return;
+    }
+  } while (!Refc_.compare_exchange_weak(Refc, Refc - 1,
+                                        std::memory_order_acq_rel));
+#ifdef TRACE_EVENT_REFCOUNTS
+  logTrace("CHIPEvent::decreaseRefCount() {} {} refc {}->{} REASON: {}",
+           (void *)this, Msg, Refc, Refc - 1, Reason);
+#endif
+  if (Refc == 1)
+    released();
 }
 
-size_t CHIPEvent::getCHIPRefc() {
-  LOCK(this->EventMtx); // CHIPEvent::Refc_
-  return *Refc_;
+void CHIPEvent::increaseRefCount(const char *Reason) {
+  size_t Refc = Refc_.fetch_add(1, std::memory_order_relaxed);
+#ifdef TRACE_EVENT_REFCOUNTS
+  logTrace("CHIPEvent::increaseRefCount() {} {} refc {}->{} REASON: {}",
+           (void *)this, Msg, Refc, Refc + 1, Reason);
+#else
+  (void)Refc;
+#endif
 }
 
 // CHIPModuleflags_
@@ -420,11 +425,260 @@ SPVFuncInfo *CHIPModule::findFunctionInfo(const std::string &FName) {
   return FuncInfos_.count(FName) ? FuncInfos_.at(FName).get() : nullptr;
 }
 
+// CHIPQueueRegistry
+//*****************************************************************************
+
+CHIPQueueRegistry::Table::Table(size_t Capacity)
+    : Mask(Capacity - 1), Slots(new std::atomic<CHIPQueue *>[Capacity]) {
+  assert((Capacity & Mask) == 0 && "Capacity must be a power of two");
+  for (size_t I = 0; I < Capacity; I++)
+    Slots[I].store(nullptr, std::memory_order_relaxed);
+}
+
+CHIPQueueRegistry::CHIPQueueRegistry() {
+  Tables_.emplace_back(std::make_unique<Table>(16));
+  Current_ = Tables_.back().get();
+}
+
+void CHIPQueueRegistry::beginWrite() {
+  Seq_.store(Seq_.load(std::memory_order_relaxed) + 1,
+             std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+void CHIPQueueRegistry::endWrite() {
+  Seq_.store(Seq_.load(std::memory_order_relaxed) + 1,
+             std::memory_order_release);
+}
+
+bool CHIPQueueRegistry::contains(const CHIPQueue *ChipQueue) const {
+  while (true) {
+    size_t Begin = Seq_.load(std::memory_order_acquire);
+    if (Begin & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    const Table *T = Current_.load(std::memory_order_relaxed);
+    bool Found = false;
+    for (size_t I = hash(ChipQueue) & T->Mask;; I = (I + 1) & T->Mask) {
+      CHIPQueue *Slot = T->Slots[I].load(std::memory_order_relaxed);
+      if (Slot == ChipQueue) {
+        Found = true;
+        break;
+      }
+      if (!Slot)
+        break;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (Seq_.load(std::memory_order_relaxed) == Begin)
+      return Found;
+  }
+}
+
+void CHIPQueueRegistry::insertNoLock(Table &T, CHIPQueue *ChipQueue) {
+  size_t I = hash(ChipQueue) & T.Mask;
+  while (T.Slots[I].load(std::memory_order_relaxed))
+    I = (I + 1) & T.Mask;
+  T.Slots[I].store(ChipQueue, std::memory_order_relaxed);
+}
+
+bool CHIPQueueRegistry::insert(CHIPQueue *ChipQueue) {
+  LOCK(WriteMtx_); // CHIPQueueRegistry::Current_
+  if (contains(ChipQueue))
+    return false;
+
+  Table *T = Current_.load(std::memory_order_relaxed);
+  // Keep the load factor at most 1/2 so the probe sequences stay short.
+  if ((Size_ + 1) * 2 > T->Mask + 1) {
+    auto Bigger = std::make_unique<Table>((T->Mask + 1) * 2);
+    for (size_t I = 0; I <= T->Mask; I++)
+      if (auto *Slot = T->Slots[I].load(std::memory_order_relaxed))
+        insertNoLock(*Bigger, Slot);
+    insertNoLock(*Bigger, ChipQueue);
+    beginWrite();
+    Current_.store(Bigger.get(), std::memory_order_relaxed);
+    endWrite();
+    Tables_.push_back(std::move(Bigger));
+  } else {
+    beginWrite();
+    insertNoLock(*T, ChipQueue);
+    endWrite();
+  }
+  Size_++;
+  return true;
+}
+
+bool CHIPQueueRegistry::erase(const CHIPQueue *ChipQueue) {
+  LOCK(WriteMtx_); // CHIPQueueRegistry::Current_
+  Table &T = *Current_.load(std::memory_order_relaxed);
+  size_t I = hash(ChipQueue) & T.Mask;
+  while (true) {
+    CHIPQueue *Slot = T.Slots[I].load(std::memory_order_relaxed);
+    if (!Slot)
+      return false;
+    if (Slot == ChipQueue)
+      break;
+    I = (I + 1) & T.Mask;
+  }
+
+  // Backward shift deletion: move the following entries of the probe
+  // sequence into the hole so no tombstones are needed.
+  beginWrite();
+  for (size_t J = (I + 1) & T.Mask;; J = (J + 1) & T.Mask) {
+    CHIPQueue *Slot = T.Slots[J].load(std::memory_order_relaxed);
+    if (!Slot)
+      break;
+    size_t Home = hash(Slot) & T.Mask;
+    // Leave the entry if its home slot is cyclically in (I, J].
+    bool Stays = I <= J ? (I < Home && Home <= J) : (I < Home || Home <= J);
+    if (Stays)
+      continue;
+    T.Slots[I].store(Slot, std::memory_order_relaxed);
+    I = J;
+  }
+  T.Slots[I].store(nullptr, std::memory_order_relaxed);
+  endWrite();
+  Size_--;
+  return true;
+}
+
+void CHIPQueueRegistry::clear() {
+  LOCK(WriteMtx_); // CHIPQueueRegistry::Current_
+  Table &T = *Current_.load(std::memory_order_relaxed);
+  beginWrite();
+  for (size_t I = 0; I <= T.Mask; I++)
+    T.Slots[I].store(nullptr, std::memory_order_relaxed);
+  endWrite();
+  Size_ = 0;
+}
+
+// CHIPSubmissionWorker
+//*****************************************************************************
+
+CHIPSubmissionWorker::CHIPSubmissionWorker(CHIPContext *ChipContext)
+    : ChipContext_(ChipContext) {
+  Thread_ = std::thread(&CHIPSubmissionWorker::run, this);
+}
+
+CHIPSubmissionWorker::~CHIPSubmissionWorker() {
+  assert(Queues_.empty() && "Queues must detach before the worker stops");
+  {
+    LOCK(SleepMtx_); // CHIPSubmissionWorker::Stop_
+    Stop_ = true;
+    WakeCV_.notify_one();
+  }
+  Thread_.join();
+}
+
+void CHIPSubmissionWorker::addQueue(CHIPQueue *ChipQueue) {
+  LOCK(QueuesMtx_); // CHIPSubmissionWorker::Queues_
+  Queues_.push_back(ChipQueue);
+}
+
+void CHIPSubmissionWorker::removeQueue(CHIPQueue *ChipQueue) {
+  LOCK(QueuesMtx_); // CHIPSubmissionWorker::Queues_
+  auto Found = std::find(Queues_.begin(), Queues_.end(), ChipQueue);
+  if (Found != Queues_.end())
+    Queues_.erase(Found);
+}
+
+void CHIPSubmissionWorker::run() {
+  IsWorkerThread_ = true;
+  // The operations look up the active device through the context stack.
+  ChipCtxStack.push(ChipContext_);
+  logDebug("Submission worker {} started", (void *)this);
+
+  auto HasPendingSubmissions = [this]() {
+    LOCK(QueuesMtx_); // CHIPSubmissionWorker::Queues_
+    for (auto *ChipQueue : Queues_)
+      if (ChipQueue->hasPendingSubmissions())
+        return true;
+    return false;
+  };
+
+  while (!Stop_) {
+    bool DidWork = false;
+    {
+      LOCK(QueuesMtx_); // CHIPSubmissionWorker::Queues_
+      for (auto *ChipQueue : Queues_)
+        DidWork |= ChipQueue->processSubmissions();
+    }
+    if (DidWork)
+      continue;
+
+    // Announce we are going to sleep before checking for work so that a
+    // producer either sees Sleeping_ set, and notifies under SleepMtx_, or
+    // we see its submission.
+    std::unique_lock<std::mutex> SleepLock(SleepMtx_);
+    Sleeping_ = true;
+    WakeCV_.wait(SleepLock,
+                 [&]() { return Stop_ || HasPendingSubmissions(); });
+    Sleeping_ = false;
+  }
+
+  logDebug("Submission worker {} stopped", (void *)this);
+}
+
+// CHIPCapturedArgs
+//*****************************************************************************
+
+CHIPCapturedArgs::CHIPCapturedArgs(const CHIPKernel &Kernel, void **Args) {
+  Kernel.captureArgs(Args, Values_, Args_);
+}
+
 // CHIPKernel
 //*************************************************************************************
 CHIPKernel::CHIPKernel(std::string HostFName, SPVFuncInfo *FuncInfo)
-    : HostFName_(HostFName), FuncInfo_(FuncInfo) {}
-CHIPKernel::~CHIPKernel(){};
+    : HostFName_(HostFName), FuncInfo_(FuncInfo) {
+  if (FuncInfo_)
+    ArgPlan_ = FuncInfo_->buildArgPlan(CHIPArgSpillBuffer::ArgAlignment,
+                                       ArgSpillSize_);
+
+  // Lay out the client argument values for captureArgs().
+  constexpr size_t Alignment = 16;
+  for (const auto &Arg : ArgPlan_) {
+    if (Arg.Kind == SPVTypeKind::Sampler || Arg.isWorkgroupPtr())
+      continue;
+    size_t Size = Arg.Kind == SPVTypeKind::Image ||
+                          Arg.Kind == SPVTypeKind::Pointer
+                      ? sizeof(void *)
+                      : Arg.Size;
+    if (CaptureOffsets_.size() <= Arg.ClientIndex) {
+      CaptureOffsets_.resize(Arg.ClientIndex + 1, 0);
+      CaptureSizes_.resize(Arg.ClientIndex + 1, 0);
+    }
+    CaptureSize_ = (CaptureSize_ + Alignment - 1) / Alignment * Alignment;
+    CaptureOffsets_[Arg.ClientIndex] = CaptureSize_;
+    CaptureSizes_[Arg.ClientIndex] = Size;
+    CaptureSize_ += Size;
+  }
+}
+
+CHIPKernel::~CHIPKernel() {
+  logDebug("Kernel {}: skipped {} of {} argument bindings", HostFName_,
+           NumArgBindingsSkipped_.load(), NumArgBindings_.load());
+};
+
+void CHIPKernel::captureArgs(void **Args, std::vector<char> &Values,
+                             std::vector<void *> &ArgPtrs) const {
+  Values.resize(CaptureSize_);
+  ArgPtrs.resize(CaptureOffsets_.size());
+  for (size_t I = 0; I < CaptureOffsets_.size(); I++) {
+    ArgPtrs[I] = Values.data() + CaptureOffsets_[I];
+    std::memcpy(ArgPtrs[I], Args[I], CaptureSizes_[I]);
+  }
+}
+
+bool CHIPKernel::isArgBound(const CHIPArgShadow &Shadow, unsigned Index,
+                            size_t Size, const void *Value) {
+  NumArgBindings_++;
+  bool Bound = Shadow.isBound(Index, Size, Value);
+  if (Bound)
+    NumArgBindingsSkipped_++;
+  return Bound;
+}
 std::string CHIPKernel::getName() { return HostFName_; }
 const void *CHIPKernel::getHostPtr() { return HostFPtr_; }
 const void *CHIPKernel::getDevPtr() { return DevFPtr_; }
@@ -435,50 +689,232 @@ void CHIPKernel::setName(std::string HostFName) { HostFName_ = HostFName; }
 void CHIPKernel::setHostPtr(const void *HostFPtr) { HostFPtr_ = HostFPtr; }
 void CHIPKernel::setDevPtr(const void *DevFPtr) { DevFPtr_ = DevFPtr; }
 
-// CHIPArgSpillBuffer
+// CHIPArgShadow
 //*****************************************************************************
 
-CHIPArgSpillBuffer::~CHIPArgSpillBuffer() { (void)Ctx_->free(DeviceBuffer_); }
+CHIPArgShadow::CHIPArgShadow(const std::vector<SPVArgPlanEntry> &ArgPlan) {
+  // Values bound via a handle or a pointer (images, samplers, spilled
+  // arguments) need at most sizeof(void *) bytes.
+  size_t TotalSize = 0;
+  for (const auto &Arg : ArgPlan) {
+    size_t Capacity = std::max<size_t>(Arg.Size, sizeof(void *));
+    Offsets_.push_back(TotalSize);
+    Capacity_.push_back(Capacity);
+    TotalSize += Capacity;
+  }
+  Values_.resize(TotalSize);
+  Sizes_.assign(ArgPlan.size(), NotBound);
+  IsNull_.assign(ArgPlan.size(), false);
+}
 
-void CHIPArgSpillBuffer::computeAndReserveSpace(const SPVFuncInfo &KernelInfo) {
-  size_t Offset = 0;
-  size_t MaxAlignment = 1;
-  auto Visitor = [&](const SPVFuncInfo::KernelArg &Arg) -> void {
-    if (Arg.Kind != SPVTypeKind::PODByRef)
-      return;
-    // FIXME: Extract alignment requirement for the argument value
-    //        from SPIR-V, store it in FuncInfo and read it
-    //        here. Using now an arbitrarily chosen value.
-    size_t Alignment = 32; // Chose sizeof(double4) as the alignment.
-    Offset = roundUp(Offset, Alignment);
-    ArgIndexToOffset_.insert(std::make_pair(Arg.Index, Offset));
-    MaxAlignment = std::max<size_t>(MaxAlignment, Alignment);
-    Offset += Arg.Size;
-  };
-  KernelInfo.visitKernelArgs(Visitor);
+bool CHIPArgShadow::isBound(unsigned Index, size_t Size,
+                            const void *Value) const {
+  if (Index >= Sizes_.size() || Sizes_[Index] != Size)
+    return false;
+
+  if (IsNull_[Index] || !Value)
+    return IsNull_[Index] && !Value;
+  return !std::memcmp(&Values_[Offsets_[Index]], Value, Size);
+}
+
+void CHIPArgShadow::record(unsigned Index, size_t Size, const void *Value) {
+  if (Index >= Sizes_.size())
+    return;
+
+  if (Value && Size > Capacity_[Index]) {
+    // Can't shadow the value.
+    Sizes_[Index] = NotBound;
+    return;
+  }
 
-  Size_ = Offset;
-  HostBuffer_ = std::make_unique<char[]>(Size_);
+  Sizes_[Index] = Size;
+  IsNull_[Index] = !Value;
+  if (Value)
+    std::memcpy(&Values_[Offsets_[Index]], Value, Size);
+}
+
+void CHIPArgShadow::invalidate() {
+  std::fill(Sizes_.begin(), Sizes_.end(), NotBound);
+}
+
+// CHIPArgSpillPool
+//*****************************************************************************
+
+CHIPArgSpillPool::CHIPArgSpillPool(CHIPContext *Ctx, hipMemoryType MemType,
+                                   size_t Capacity)
+    : Ctx_(Ctx), HostVisible_(MemType == hipMemoryTypeHost),
+      Capacity_(Capacity) {
+  assert(Capacity_ % CHIPArgSpillBuffer::ArgAlignment == 0);
   DeviceBuffer_ = static_cast<char *>(
-      Ctx_->allocate(Size_, MaxAlignment, hipMemoryTypeDevice));
+      Ctx_->allocate(Capacity_, CHIPArgSpillBuffer::ArgAlignment, MemType));
+  // Without the ring the spill buffers are allocated separately.
+  if (!DeviceBuffer_)
+    logWarn("Could not allocate the argument spill pool");
+  else if (!HostVisible_)
+    HostBuffer_ = std::make_unique<char[]>(Capacity_);
+}
+
+CHIPArgSpillPool::~CHIPArgSpillPool() {
+  // The queue has finished its launches by the time the pool is destroyed.
+  for (auto &Used : InUse_)
+    if (Used.Event)
+      Used.Event->decreaseRefCount("~CHIPArgSpillPool");
+  for (auto &Buf : Detached_) {
+    if (Buf.Event)
+      Buf.Event->decreaseRefCount("~CHIPArgSpillPool");
+    (void)Ctx_->free(Buf.DeviceBuffer);
+  }
+  if (DeviceBuffer_)
+    (void)Ctx_->free(DeviceBuffer_);
+}
+
+void CHIPArgSpillPool::reclaim(bool Query) {
+  while (!InUse_.empty() && InUse_.front().Released) {
+    CHIPEvent *Event = InUse_.front().Event;
+    if (Event) {
+      if (Query && !Event->isDone())
+        Event->updateFinishStatus(false);
+      if (!Event->isDone())
+        return;
+      Event->decreaseRefCount("CHIPArgSpillPool::reclaim");
+    }
+    // Only the oldest launch is queried. The later ones are usually
+    // still running.
+    Query = false;
+    InUse_.pop_front();
+  }
+}
+
+void CHIPArgSpillPool::reclaimDetached() {
+  while (!Detached_.empty()) {
+    auto &Buf = Detached_.front();
+    if (Buf.Event) {
+      if (!Buf.Event->isDone())
+        return;
+      Buf.Event->decreaseRefCount("CHIPArgSpillPool::reclaimDetached");
+    }
+    (void)Ctx_->free(Buf.DeviceBuffer);
+    Detached_.pop_front();
+  }
+}
+
+bool CHIPArgSpillPool::acquire(size_t Size, char *&HostPtr, char *&DevicePtr,
+                               size_t &SliceEnd) {
+  constexpr size_t Alignment = CHIPArgSpillBuffer::ArgAlignment;
+  Size = (Size + Alignment - 1) / Alignment * Alignment;
+  if (!DeviceBuffer_ || Size > Capacity_)
+    return false;
+
+  LOCK(PoolMtx_); // CHIPArgSpillPool::InUse_
+  // Slices are contiguous. Skip the end of the ring if the slice does not
+  // fit there.
+  size_t Begin = Tail_;
+  if (Begin % Capacity_ + Size > Capacity_)
+    Begin += Capacity_ - Begin % Capacity_;
+  auto Fits = [&]() {
+    size_t Head = InUse_.empty() ? Tail_ : InUse_.front().Start;
+    return Begin + Size - Head <= Capacity_;
+  };
+  // The completed launches are usually noticed by the event monitor. Ask
+  // the driver only when the ring would be full otherwise.
+  reclaim(false);
+  reclaimDetached();
+  if (!Fits())
+    reclaim(true);
+  if (!Fits())
+    return false;
+
+  InUse_.push_back({Tail_, Begin + Size, false, nullptr});
+  Tail_ = Begin + Size;
+  SliceEnd = Tail_;
+  DevicePtr = DeviceBuffer_ + Begin % Capacity_;
+  HostPtr = HostVisible_ ? DevicePtr : HostBuffer_.get() + Begin % Capacity_;
+  return true;
 }
 
-void *CHIPArgSpillBuffer::allocate(const SPVFuncInfo::Arg &Arg) {
-  assert(HostBuffer_ && DeviceBuffer_ &&
-         "Forgot to call computeAndReserveSpace()?");
-  auto Offset = ArgIndexToOffset_[Arg.Index];
-  auto *HostPtr = HostBuffer_.get() + Offset;
-  assert(Arg.Data);
-  std::memcpy(HostPtr, Arg.Data, Arg.Size);
-  return DeviceBuffer_ + Offset;
+void CHIPArgSpillPool::release(size_t SliceEnd, CHIPEvent *Event) {
+  // Released by reclaim().
+  if (Event)
+    Event->increaseRefCount("CHIPArgSpillPool::release");
+  LOCK(PoolMtx_); // CHIPArgSpillPool::InUse_
+  for (auto &Used : InUse_)
+    if (Used.End == SliceEnd) {
+      Used.Released = true;
+      Used.Event = Event;
+      break;
+    }
+  reclaim(false);
+}
+
+void CHIPArgSpillPool::release(std::unique_ptr<char[]> HostBuffer,
+                               char *DeviceBuffer, CHIPEvent *Event) {
+  if (!Event) {
+    (void)Ctx_->free(DeviceBuffer);
+    return;
+  }
+  // Released by reclaimDetached().
+  Event->increaseRefCount("CHIPArgSpillPool::release");
+  LOCK(PoolMtx_); // CHIPArgSpillPool::Detached_
+  Detached_.push_back({std::move(HostBuffer), DeviceBuffer, Event});
+  reclaimDetached();
+}
+
+// CHIPArgSpillBuffer
+//*****************************************************************************
+
+void CHIPArgSpillBuffer::reserveSpace(std::shared_ptr<CHIPArgSpillPool> Pool,
+                                      const CHIPKernel &Kernel) {
+  release(nullptr);
+  Pool_ = std::move(Pool);
+  Size_ = Kernel.getArgSpillSize();
+  InRing_ = Pool_->acquire(Size_, HostBuffer_, DeviceBuffer_, SliceEnd_);
+  if (InRing_)
+    return;
+
+  // The ring is full: fall back to a separate allocation.
+  OwnHostBuffer_ = std::make_unique<char[]>(Size_);
+  HostBuffer_ = OwnHostBuffer_.get();
+  DeviceBuffer_ = static_cast<char *>(Pool_->getContext()->allocate(
+      Size_, ArgAlignment, hipMemoryTypeDevice));
+}
+
+void CHIPArgSpillBuffer::release(CHIPEvent *LaunchEvent) {
+  if (!Pool_)
+    return;
+  if (InRing_)
+    Pool_->release(SliceEnd_, LaunchEvent);
+  else
+    Pool_->release(std::move(OwnHostBuffer_), DeviceBuffer_, LaunchEvent);
+  Pool_.reset();
+  HostBuffer_ = nullptr;
+  DeviceBuffer_ = nullptr;
+  Size_ = 0;
+}
+
+void *CHIPArgSpillBuffer::allocate(const SPVArgPlanEntry &Arg,
+                                   const void *ArgData) {
+  assert(HostBuffer_ && DeviceBuffer_ && "Forgot to call reserveSpace()?");
+  assert(Arg.Kind == SPVTypeKind::PODByRef);
+  assert(Arg.SpillOffset + Arg.Size <= Size_);
+  auto *HostPtr = HostBuffer_ + Arg.SpillOffset;
+  assert(ArgData);
+  std::memcpy(HostPtr, ArgData, Arg.Size);
+  return DeviceBuffer_ + Arg.SpillOffset;
 }
 
 // CHIPExecItem
 //*************************************************************************************
 void CHIPExecItem::copyArgs(void **Args) {
-  for (int i = 0; i < getNumArgs(); i++) {
-    Args_.push_back(Args[i]);
-  }
+  // assign() reuses the existing capacity when the exec item is recycled.
+  Args_.assign(Args, Args + getNumArgs());
+}
+
+void CHIPExecItem::reset(dim3 GridDim, dim3 BlockDim, size_t SharedMem) {
+  GridDim_ = GridDim;
+  BlockDim_ = BlockDim;
+  SharedMem_ = SharedMem;
+  Args_.clear();
+  ArgSpillBuffer_.release(nullptr);
 }
 
 CHIPExecItem::CHIPExecItem(dim3 GridDim, dim3 BlockDim, size_t SharedMem,
@@ -502,16 +938,80 @@ CHIPDevice::CHIPDevice(CHIPContext *Ctx, int DeviceIdx)
 CHIPDevice::~CHIPDevice() {
   LOCK(DeviceMtx); // CHIPDevice::ChipQueues_
   logDebug("~CHIPDevice() {}", (void *)this);
+  std::unique_lock<std::shared_mutex> DeleteLock(QueueDeleteMtx);
   while (this->ChipQueues_.size() > 0) {
+    QueueRegistry_.erase(ChipQueues_[0]);
     delete ChipQueues_[0];
     ChipQueues_.erase(ChipQueues_.begin());
   }
 
   delete LegacyDefaultQueue;
   LegacyDefaultQueue = nullptr;
+
+  for (void *Block : AbortFlagBlocks_)
+    (void)Ctx_->free(Block);
 }
 CHIPQueue *CHIPDevice::getLegacyDefaultQueue() { return LegacyDefaultQueue; }
 
+CHIPQueueTimeline *CHIPDevice::acquireTimeline() {
+  LOCK(TimelinesMtx_); // CHIPDevice::Timelines_
+  if (FreeTimelines_.size()) {
+    CHIPQueueTimeline *Timeline = FreeTimelines_.back();
+    FreeTimelines_.pop_back();
+    return Timeline;
+  }
+  Timelines_.push_back(std::make_unique<CHIPQueueTimeline>());
+  return Timelines_.back().get();
+}
+
+void CHIPDevice::releaseTimeline(CHIPQueueTimeline *Timeline) {
+  // The events of the queue may still be queried. Once all its commands are
+  // complete, the numbering of a new queue continuing from there does not
+  // change their outcome.
+  if (!Timeline->isIdle())
+    return;
+  LOCK(TimelinesMtx_); // CHIPDevice::FreeTimelines_
+  FreeTimelines_.push_back(Timeline);
+}
+
+CHIPSubmissionWorker *CHIPDevice::getSubmissionWorker() {
+  std::call_once(SubmissionWorkerCreated_, [&]() {
+    SubmissionWorker_ = std::make_unique<CHIPSubmissionWorker>(getContext());
+  });
+  return SubmissionWorker_.get();
+}
+
+void CHIPDevice::waitForQueues() {
+  std::vector<CHIPQueue *> Queues;
+  std::vector<CHIPEvent *> Events;
+  // Keeps the queues alive once DeviceMtx is released.
+  std::shared_lock<std::shared_mutex> DeleteLock;
+  {
+    LOCK(DeviceMtx); // CHIPDevice::ChipQueues_
+    DeleteLock = std::shared_lock<std::shared_mutex>(QueueDeleteMtx);
+    Queues = ChipQueues_;
+    Queues.push_back(LegacyDefaultQueue);
+    if (PerThreadStreamUsed_)
+      Queues.push_back(getPerThreadDefaultQueueNoLock());
+    for (auto *Q : Queues)
+      if (auto *Event = Q->acquireLastEvent())
+        Events.push_back(Event);
+  }
+
+  waitForEvents(Events);
+  for (auto *Event : Events)
+    Event->decreaseRefCount("waitForQueues");
+
+  for (auto *Q : Queues)
+    Q->drainPrintfBuffers();
+}
+
+void CHIPDevice::waitForEvents(const std::vector<CHIPEvent *> &Events) {
+  // The events are in flight so the time is that of the slowest one.
+  for (auto *Event : Events)
+    Event->wait();
+}
+
 CHIPQueue *CHIPDevice::getDefaultQueue() {
 #ifdef HIP_API_PER_THREAD_DEFAULT_STREAM
   return getPerThreadDefaultQueue();
@@ -558,6 +1058,14 @@ std::vector<CHIPKernel *> CHIPDevice::getKernels() {
   return ChipKernels;
 }
 
+void CHIPDevice::releaseKernelHandles(const CHIPQueue *ChipQueue) {
+  // Queues are deleted under DeviceMtx.
+  LOCK(DeviceVarMtx); // CHIPDevice::SrcModToCompiledMod_
+  for (auto &Kv : SrcModToCompiledMod_)
+    for (CHIPKernel *Kernel : Kv.second->getKernels())
+      Kernel->releaseHandle(ChipQueue);
+}
+
 std::string CHIPDevice::getName() { return std::string(HipDeviceProps_.name); }
 
 void CHIPDevice::init() {
@@ -789,6 +1297,16 @@ int CHIPDevice::getAttr(hipDeviceAttribute_t Attr) {
 size_t CHIPDevice::getGlobalMemSize() { return HipDeviceProps_.totalGlobalMem; }
 
 void CHIPDevice::eraseModule(CHIPModule *Module) {
+  waitForAbortFetches(Module);
+  {
+    LOCK(AbortWatchMtx_); // CHIPDevice::AbortWatchedModules_
+    AbortWatchedModules_.erase(std::remove(AbortWatchedModules_.begin(),
+                                           AbortWatchedModules_.end(), Module),
+                               AbortWatchedModules_.end());
+    AbortedModules_.erase(std::remove(AbortedModules_.begin(),
+                                      AbortedModules_.end(), Module),
+                          AbortedModules_.end());
+  }
   LOCK(DeviceMtx); // SrcModToCompiledMod_
   for (auto &Kv : SrcModToCompiledMod_)
     if (Kv.second == Module) {
@@ -798,6 +1316,128 @@ void CHIPDevice::eraseModule(CHIPModule *Module) {
     }
 }
 
+// Disables host-side abort behavior for making the unit testing of abort
+// cases easier.
+static bool hostIgnoresDeviceAbort() {
+  return getenv("CHIP_HOST_IGNORES_DEVICE_ABORT") != nullptr;
+}
+
+std::atomic<int32_t> *CHIPDevice::acquireAbortFlag() {
+  // The flags are written by 4 byte copies.
+  static_assert(sizeof(std::atomic<int32_t>) == sizeof(int32_t));
+  constexpr size_t SlotsPerBlock = 64;
+
+  LOCK(AbortWatchMtx_); // CHIPDevice::FreeAbortFlags_
+  if (FreeAbortFlags_.empty()) {
+    void *Block = Ctx_->allocate(SlotsPerBlock * sizeof(int32_t),
+                                 hipMemoryType::hipMemoryTypeHost);
+    if (!Block)
+      CHIPERR_LOG_AND_THROW("Could not allocate abort flags",
+                            hipErrorOutOfMemory);
+    AbortFlagBlocks_.push_back(Block);
+    auto *Slots = static_cast<int32_t *>(Block);
+    for (size_t i = 0; i < SlotsPerBlock; i++)
+      FreeAbortFlags_.push_back(new (&Slots[i]) std::atomic<int32_t>(0));
+  }
+  std::atomic<int32_t> *Flag = FreeAbortFlags_.back();
+  FreeAbortFlags_.pop_back();
+  return Flag;
+}
+
+void CHIPDevice::watchAbortFetch(CHIPModule *Module,
+                                 std::atomic<int32_t> *Flag,
+                                 CHIPEvent *Event) {
+  // Released by finishAbortFetches().
+  Event->increaseRefCount("watchAbortFetch");
+  size_t Id;
+  {
+    LOCK(AbortWatchMtx_); // CHIPDevice::AbortFetches_
+    Id = NextAbortFetchId_++;
+    AbortFetches_.push_back({Id, Module, Flag, Event});
+    if (std::find(AbortWatchedModules_.begin(), AbortWatchedModules_.end(),
+                  Module) == AbortWatchedModules_.end())
+      AbortWatchedModules_.push_back(Module);
+  }
+  Event->addAction([this, Id]() { endAbortFetch(Id); });
+}
+
+void CHIPDevice::endAbortFetch(size_t Id) {
+  // The fetch is gone if a synchronization has checked it already.
+  finishAbortFetches([Id](AbortFetch &Fetch) { return Fetch.Id == Id; });
+}
+
+void CHIPDevice::checkAbortFetches() {
+  finishAbortFetches([](AbortFetch &Fetch) {
+    Fetch.Event->updateFinishStatus(false);
+    return Fetch.Event->isDone();
+  });
+}
+
+void CHIPDevice::finishAbortFetches(
+    const std::function<bool(AbortFetch &)> &IsDone) {
+  std::vector<CHIPEvent *> Events;
+  bool Aborted = false;
+  {
+    LOCK(AbortWatchMtx_); // CHIPDevice::AbortFetches_
+    auto Done = std::stable_partition(
+        AbortFetches_.begin(), AbortFetches_.end(),
+        [&](AbortFetch &Fetch) { return !IsDone(Fetch); });
+    for (auto It = Done; It != AbortFetches_.end(); ++It) {
+      if (It->Flag->load() != 0) {
+        Aborted = true;
+        if (std::find(AbortedModules_.begin(), AbortedModules_.end(),
+                      It->Module) == AbortedModules_.end())
+          AbortedModules_.push_back(It->Module);
+      }
+      FreeAbortFlags_.push_back(It->Flag);
+      Events.push_back(It->Event);
+    }
+    AbortFetches_.erase(Done, AbortFetches_.end());
+  }
+
+  for (auto *Event : Events)
+    Event->decreaseRefCount("finishAbortFetches");
+  if (Aborted && !hostIgnoresDeviceAbort())
+    abort();
+}
+
+void CHIPDevice::waitForAbortFetches(CHIPModule *Module) {
+  {
+    LOCK(AbortWatchMtx_); // CHIPDevice::AbortWatchedModules_
+    if (Module ? std::find(AbortWatchedModules_.begin(),
+                           AbortWatchedModules_.end(),
+                           Module) == AbortWatchedModules_.end()
+               : AbortWatchedModules_.empty())
+      return;
+  }
+
+  // Submits the deferred fetches.
+  waitForQueues();
+
+  // The fetches on the destroyed queues are not covered above.
+  std::vector<CHIPEvent *> Events;
+  {
+    LOCK(AbortWatchMtx_); // CHIPDevice::AbortFetches_
+    for (auto &Fetch : AbortFetches_)
+      if (!Module || Fetch.Module == Module) {
+        Fetch.Event->increaseRefCount("waitForAbortFetches");
+        Events.push_back(Fetch.Event);
+      }
+  }
+  for (auto *Event : Events) {
+    Event->wait();
+    Event->decreaseRefCount("waitForAbortFetches");
+  }
+  checkAbortFetches();
+}
+
+std::vector<CHIPModule *> CHIPDevice::takeAbortedModules() {
+  LOCK(AbortWatchMtx_); // CHIPDevice::AbortedModules_
+  std::vector<CHIPModule *> Modules;
+  Modules.swap(AbortedModules_);
+  return Modules;
+}
+
 void CHIPDevice::addQueue(CHIPQueue *ChipQueue) {
   LOCK(DeviceMtx) // writing CHIPDevice::ChipQueues_
   logDebug("{} CHIPDevice::addQueue({})", (void *)this, (void *)ChipQueue);
@@ -806,6 +1446,7 @@ void CHIPDevice::addQueue(CHIPQueue *ChipQueue) {
       std::find(ChipQueues_.begin(), ChipQueues_.end(), ChipQueue);
   if (QueueFound == ChipQueues_.end()) {
     ChipQueues_.push_back(ChipQueue);
+    QueueRegistry_.insert(ChipQueue);
   } else {
     CHIPERR_LOG_AND_THROW("Tried to add a queue to the backend which was "
                           "already present in the backend queue list",
@@ -818,12 +1459,15 @@ void CHIPDevice::addQueue(CHIPQueue *ChipQueue) {
 }
 
 void CHIPEvent::track() {
-  LOCK(Backend->EventsMtx); // trackImpl CHIPBackend::Events
-  LOCK(EventMtx);           // writing bool CHIPEvent::TrackCalled_
-  if (!TrackCalled_) {
+  {
+    LOCK(Backend->EventsMtx); // trackImpl CHIPBackend::Events
+    LOCK(EventMtx);           // writing bool CHIPEvent::TrackCalled_
+    if (TrackCalled_)
+      return;
     Backend->Events.push_back(this);
     TrackCalled_ = true;
   }
+  Backend->EventsCond.notify_one();
 }
 
 CHIPQueue *CHIPDevice::createQueueAndRegister(CHIPQueueFlags Flags,
@@ -843,6 +1487,12 @@ CHIPQueue *CHIPDevice::createQueueAndRegister(const uintptr_t *NativeHandles,
   return ChipQueue;
 }
 
+void CHIPDevice::clearQueues() {
+  LOCK(DeviceMtx); // CHIPDevice::ChipQueues_
+  ChipQueues_.clear();
+  QueueRegistry_.clear();
+}
+
 std::vector<CHIPQueue *> &CHIPDevice::getQueues() {
   LOCK(DeviceMtx); // reading CHIPDevice::ChipQueues_
   return ChipQueues_;
@@ -880,20 +1530,29 @@ bool CHIPDevice::removeQueue(CHIPQueue *ChipQueue) {
    *
    * Choosing not to call Queue->finish()
    */
-  LOCK(DeviceMtx) // reading CHIPDevice::ChipQueues_
-  ChipQueue->updateLastEvent(nullptr);
-
-  // Remove from device queue list
-  auto FoundQueue =
-      std::find(ChipQueues_.begin(), ChipQueues_.end(), ChipQueue);
-  if (FoundQueue == ChipQueues_.end()) {
-    std::string Msg =
-        "Tried to remove a queue for a device but the queue was not found in "
-        "device queue list";
-    CHIPERR_LOG_AND_THROW(Msg, hipErrorUnknown);
+  {
+    LOCK(DeviceMtx) // reading CHIPDevice::ChipQueues_
+    ChipQueue->updateLastEvent(nullptr);
+
+    // Remove from device queue list
+    auto FoundQueue =
+        std::find(ChipQueues_.begin(), ChipQueues_.end(), ChipQueue);
+    if (FoundQueue == ChipQueues_.end()) {
+      std::string Msg =
+          "Tried to remove a queue for a device but the queue was not found "
+          "in device queue list";
+      CHIPERR_LOG_AND_THROW(Msg, hipErrorUnknown);
+    }
+    ChipQueues_.erase(FoundQueue);
+    QueueRegistry_.erase(ChipQueue);
+    LegacyDefaultQueue->forgetSyncNoLock(*ChipQueue);
+    for (auto *Q : ChipQueues_)
+      Q->forgetSyncNoLock(*ChipQueue);
   }
-  ChipQueues_.erase(FoundQueue);
 
+  // A concurrent hipDeviceSynchronize() may still use the queue. Waiting
+  // for it doesn't hold up the other queues of the device.
+  std::unique_lock<std::shared_mutex> DeleteLock(QueueDeleteMtx);
   delete ChipQueue;
   return true;
 }
@@ -1030,6 +1689,9 @@ CHIPModule *CHIPDevice::getOrCreateModule(const SPVModule &SrcMod) {
 CHIPContext::CHIPContext() {}
 CHIPContext::~CHIPContext() {
   logDebug("~CHIPContext() {}", (void *)this);
+  logDebug("syncQueues: elided {} of {} barriers",
+           NumSyncBarriersElided_.load(),
+           NumSyncBarriers_.load() + NumSyncBarriersElided_.load());
   delete ChipDevice_;
 }
 
@@ -1069,26 +1731,41 @@ void CHIPContext::syncQueues(CHIPQueue *TargetQueue) {
 
   // default stream waits on all blocking streams to complete
   std::vector<CHIPEvent *> EventsToWaitOn;
+  std::vector<std::pair<CHIPQueue *, size_t>> EpochsToWaitOn;
+
+  // The target only needs to wait for the queues which have submitted work
+  // since it last waited for them.
+  auto addQueueToWaitOn = [&](CHIPQueue *Q) {
+    // Read the epoch first: the last event is then at least as new.
+    size_t Epoch = Q->getSubmitEpoch();
+    if (TargetQueue->hasSyncedWithNoLock(*Q, Epoch))
+      return;
+    if (auto Ev = Q->getLastEvent())
+      EventsToWaitOn.push_back(Ev);
+    EpochsToWaitOn.emplace_back(Q, Epoch);
+  };
 
-  CHIPEvent *SyncQueuesEvent;
   if (TargetQueue == DefaultQueue) {
-    for (auto &q : QueuesToSyncWith) {
-      auto Ev = q->getLastEvent();
-      if (Ev)
-        EventsToWaitOn.push_back(Ev);
-    }
-    SyncQueuesEvent = TargetQueue->enqueueBarrierImpl(&EventsToWaitOn);
-    SyncQueuesEvent->Msg = "barrierSyncQueue";
-    TargetQueue->updateLastEvent(SyncQueuesEvent);
+    for (auto &q : QueuesToSyncWith)
+      addQueueToWaitOn(q);
   } else { // blocking stream must wait until default stream is done
-    auto Ev = DefaultQueue->getLastEvent();
-    if (Ev)
-      EventsToWaitOn.push_back(Ev);
-    SyncQueuesEvent = TargetQueue->enqueueBarrierImpl(&EventsToWaitOn);
+    addQueueToWaitOn(DefaultQueue);
+  }
+
+  if (EventsToWaitOn.empty()) {
+    NumSyncBarriersElided_++;
+  } else {
+    NumSyncBarriers_++;
+    CHIPEvent *SyncQueuesEvent =
+        TargetQueue->enqueueBarrierImpl(&EventsToWaitOn);
     SyncQueuesEvent->Msg = "barrierSyncQueue";
-    TargetQueue->updateLastEvent(SyncQueuesEvent);
+    // The barrier is not new work for the other queues to wait on.
+    TargetQueue->updateLastEvent(SyncQueuesEvent, false);
+    SyncQueuesEvent->track();
   }
-  SyncQueuesEvent->track();
+
+  for (auto &QueueAndEpoch : EpochsToWaitOn)
+    TargetQueue->recordSyncNoLock(*QueueAndEpoch.first, QueueAndEpoch.second);
 }
 
 CHIPDevice *CHIPContext::getDevice() {
@@ -1268,7 +1945,7 @@ void CHIPBackend::waitForThreadExit() {
         logWarn("Make sure to call hipStreamDestroy() for all queues that have "
                 "been created via hipStreamCreate()");
         logWarn("Removing user-created streams without calling a destructor");
-        Dev->getQueues().clear();
+        Dev->clearQueues();
         if (Backend->Events.size()) {
           logWarn("Clearing Event list {}", Backend->Events.size());
           Backend->Events.clear();
@@ -1459,38 +2136,35 @@ CHIPDevice *CHIPBackend::findDeviceMatchingProps(const hipDeviceProp_t *Props) {
 
 CHIPQueue *CHIPBackend::findQueue(CHIPQueue *ChipQueue) {
   auto Dev = Backend->getActiveDevice();
-  LOCK(Dev->DeviceMtx); // CHIPDevice::ChipQueues_ via getQueuesNoLock()
 
   if (ChipQueue == hipStreamPerThread) {
-    return Dev->getPerThreadDefaultQueueNoLock();
+    return Dev->getPerThreadDefaultQueue();
   } else if (ChipQueue == hipStreamLegacy) {
     return Dev->getLegacyDefaultQueue();
   } else if (ChipQueue == nullptr) {
     return Dev->getDefaultQueue();
   }
-  std::vector<CHIPQueue *> AllQueues;
-  if (Dev->isPerThreadStreamUsedNoLock())
-    AllQueues.push_back(Dev->getPerThreadDefaultQueueNoLock());
-  AllQueues.push_back(Dev->getLegacyDefaultQueue());
 
-  for (auto &Dev : Dev->getQueuesNoLock()) {
-    AllQueues.push_back(Dev);
-  }
+  // Called on every stream taking API call: validate the handle without
+  // locking.
+  if (ChipQueue == Dev->getLegacyDefaultQueue() ||
+      ChipQueue == CHIPDevice::PerThreadDefaultQueue.get() ||
+      Dev->hasQueue(ChipQueue))
+    return ChipQueue;
 
-  auto QueueFound = std::find(AllQueues.begin(), AllQueues.end(), ChipQueue);
-  if (QueueFound == AllQueues.end())
-    CHIPERR_LOG_AND_THROW("CHIPBackend::findQueue() was given a non-nullptr "
-                          "queue but this queue "
-                          "was not found among the backend queues.",
-                          hipErrorTbd);
-  return *QueueFound;
+  CHIPERR_LOG_AND_THROW("CHIPBackend::findQueue() was given a non-nullptr "
+                        "queue but this queue "
+                        "was not found among the backend queues.",
+                        hipErrorTbd);
 }
 
 // CHIPQueue
 //*************************************************************************************
 CHIPQueue::CHIPQueue(CHIPDevice *ChipDevice, CHIPQueueFlags Flags, int Priority)
-    : Priority_(Priority), QueueFlags_(Flags), ChipDevice_(ChipDevice) {
+    : Priority_(Priority), QueueFlags_(Flags), ChipDevice_(ChipDevice),
+      Uid_(NextUid_++) {
   ChipContext_ = ChipDevice->getContext();
+  Timeline_ = ChipDevice->acquireTimeline();
   logDebug("CHIPQueue() {}", (void *)this);
 };
 
@@ -1498,14 +2172,150 @@ CHIPQueue::CHIPQueue(CHIPDevice *ChipDevice, CHIPQueueFlags Flags)
     : CHIPQueue(ChipDevice, Flags, 0){};
 
 CHIPQueue::~CHIPQueue() {
+  // Backends must detach before their part of the queue is destroyed.
+  assert(!SubmissionWorker_ && "Forgot to call detachSubmissionWorker()?");
   updateLastEvent(nullptr);
+  ChipDevice_->releaseTimeline(Timeline_);
   if (PerThreadQueueForDevice) {
     PerThreadQueueForDevice->setPerThreadStreamUsed(false);
   }
 };
 
+bool CHIPQueue::canSubmitAsync() const {
+#ifdef ENFORCE_QUEUE_SYNC
+  // The implicit synchronization between queues relies on the operations
+  // being submitted in the order they were called.
+  return false;
+#else
+  return CHIPAsyncSubmit && !CHIPSubmissionWorker::isWorkerThread();
+#endif
+}
+
+CHIPQueue::CHIPSubmission *
+CHIPQueue::beginSubmission(std::unique_lock<std::mutex> &Lock) {
+  if (!canSubmitAsync())
+    return nullptr;
+
+  // CHIPQueue::Submissions_ producer side
+  Lock = std::unique_lock<std::mutex>(SubmitMtx_);
+  if (!SubmissionWorker_) {
+    Submissions_ = std::make_unique<CHIPSPSCRing<CHIPSubmission, 1024>>();
+    SubmissionWorker_ = getDevice()->getSubmissionWorker();
+    SubmissionWorker_->addQueue(this);
+  }
+
+  // Report the failure of an earlier deferred operation.
+  throwSubmissionError();
+
+  CHIPSubmission *Submission;
+  while (!(Submission = Submissions_->back())) {
+    // The ring is full. Wait for the worker to catch up.
+    SubmissionWorker_->notify();
+    std::this_thread::yield();
+  }
+  return Submission;
+}
+
+void CHIPQueue::commitSubmission() {
+  Submissions_->push();
+  NumSubmissionsPushed_++;
+  SubmissionWorker_->notify();
+}
+
+bool CHIPQueue::submitAsync(std::function<void()> &&Op) {
+  std::unique_lock<std::mutex> Lock;
+  CHIPSubmission *Submission = beginSubmission(Lock);
+  if (!Submission)
+    return false;
+  Submission->Op = std::move(Op);
+  commitSubmission();
+  return true;
+}
+
+void CHIPQueue::waitForSubmissions() {
+  if (!SubmissionWorker_ || CHIPSubmissionWorker::isWorkerThread())
+    return;
+
+  size_t Pushed = NumSubmissionsPushed_;
+  if (NumSubmissionsDone_ < Pushed) {
+    SubmissionWorker_->notify();
+    std::unique_lock<std::mutex> Lock(SubmissionsDoneMtx_);
+    SubmissionsDoneCV_.wait(Lock,
+                            [&]() { return NumSubmissionsDone_ >= Pushed; });
+  }
+  throwSubmissionError();
+}
+
+bool CHIPQueue::processSubmissions() {
+  bool DidWork = false;
+  while (CHIPSubmission *Submission = Submissions_->front()) {
+    DidWork = true;
+    try {
+      if (Submission->Kernel)
+        launchKernel(Submission->Kernel, Submission->NumBlocks,
+                     Submission->DimBlocks, Submission->Args.data(),
+                     Submission->SharedMemBytes);
+      else
+        Submission->Op();
+    } catch (CHIPError &Err) {
+      logError("Deferred operation on queue {} failed: {}", (void *)this,
+               Err.getMsgStr());
+      storeSubmissionError(Err);
+    } catch (...) {
+      // Waiters must be released whatever the operation threw.
+      logError("Deferred operation on queue {} failed", (void *)this);
+      storeSubmissionError(
+          CHIPError("Deferred operation failed", hipErrorTbd));
+    }
+    // The argument buffers are kept for the next launch in the slot.
+    Submission->Op = nullptr;
+    Submission->Kernel = nullptr;
+    Submissions_->pop();
+    {
+      LOCK(SubmissionsDoneMtx_); // CHIPQueue::NumSubmissionsDone_ waiters
+      NumSubmissionsDone_++;
+    }
+    SubmissionsDoneCV_.notify_all();
+  }
+  return DidWork;
+}
+
+bool CHIPQueue::hasPendingSubmissions() const {
+  return NumSubmissionsDone_ != NumSubmissionsPushed_;
+}
+
+void CHIPQueue::storeSubmissionError(const CHIPError &Err) {
+  LOCK(SubmissionErrorMtx_); // CHIPQueue::SubmissionError_
+  if (!SubmissionError_)
+    SubmissionError_ = std::make_unique<CHIPError>(Err);
+}
+
+void CHIPQueue::throwSubmissionError() {
+  std::unique_ptr<CHIPError> Err;
+  {
+    LOCK(SubmissionErrorMtx_); // CHIPQueue::SubmissionError_
+    Err = std::move(SubmissionError_);
+  }
+  if (Err)
+    throw *Err;
+}
+
+void CHIPQueue::detachSubmissionWorker() {
+  if (!SubmissionWorker_)
+    return;
+
+  try {
+    waitForSubmissions();
+  } catch (CHIPError &Err) {
+    logError("Ignoring a failed deferred operation of a destroyed queue");
+  }
+  SubmissionWorker_->removeQueue(this);
+  SubmissionWorker_ = nullptr;
+}
+
 ///////// Enqueue Operations //////////
 hipError_t CHIPQueue::memCopy(void *Dst, const void *Src, size_t Size) {
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1539,6 +2349,9 @@ hipError_t CHIPQueue::memCopy(void *Dst, const void *Src, size_t Size) {
   return hipSuccess;
 }
 void CHIPQueue::memCopyAsync(void *Dst, const void *Src, size_t Size) {
+  if (submitAsync([=]() { memCopyAsync(Dst, Src, Size); }))
+    return;
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1548,8 +2361,23 @@ void CHIPQueue::memCopyAsync(void *Dst, const void *Src, size_t Size) {
   ChipEvent->track();
   return;
 }
+void CHIPQueue::fetchAbortFlag(CHIPModule *Module, const void *DevFlag) {
+  if (submitAsync([=]() { fetchAbortFlag(Module, DevFlag); }))
+    return;
+  waitForSubmissions();
+#ifdef ENFORCE_QUEUE_SYNC
+  ChipContext_->syncQueues(this);
+#endif
+  std::atomic<int32_t> *Flag = ChipDevice_->acquireAbortFlag();
+  auto ChipEvent = memCopyAsyncImpl(Flag, DevFlag, sizeof(int32_t));
+  ChipEvent->Msg = "fetchAbortFlag";
+  ChipDevice_->watchAbortFetch(Module, Flag, ChipEvent);
+  updateLastEvent(ChipEvent);
+  ChipEvent->track();
+}
 void CHIPQueue::memFill(void *Dst, size_t Size, const void *Pattern,
                         size_t PatternSize) {
+  waitForSubmissions();
   {
 #ifdef ENFORCE_QUEUE_SYNC
     ChipContext_->syncQueues(this);
@@ -1566,6 +2394,15 @@ void CHIPQueue::memFill(void *Dst, size_t Size, const void *Pattern,
 
 void CHIPQueue::memFillAsync(void *Dst, size_t Size, const void *Pattern,
                              size_t PatternSize) {
+  if (canSubmitAsync()) {
+    auto *PatternBytes = static_cast<const char *>(Pattern);
+    std::vector<char> PatternCopy(PatternBytes, PatternBytes + PatternSize);
+    if (submitAsync([=]() {
+          memFillAsync(Dst, Size, PatternCopy.data(), PatternSize);
+        }))
+      return;
+  }
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1577,6 +2414,7 @@ void CHIPQueue::memFillAsync(void *Dst, size_t Size, const void *Pattern,
 }
 void CHIPQueue::memCopy2D(void *Dst, size_t DPitch, const void *Src,
                           size_t SPitch, size_t Width, size_t Height) {
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1589,6 +2427,7 @@ void CHIPQueue::memCopy2D(void *Dst, size_t DPitch, const void *Src,
 
 void CHIPQueue::memCopy2DAsync(void *Dst, size_t DPitch, const void *Src,
                                size_t SPitch, size_t Width, size_t Height) {
+  waitForSubmissions();
   {
 #ifdef ENFORCE_QUEUE_SYNC
     ChipContext_->syncQueues(this);
@@ -1606,6 +2445,7 @@ void CHIPQueue::memCopy2DAsync(void *Dst, size_t DPitch, const void *Src,
 void CHIPQueue::memCopy3D(void *Dst, size_t DPitch, size_t DSPitch,
                           const void *Src, size_t SPitch, size_t SSPitch,
                           size_t Width, size_t Height, size_t Depth) {
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1621,6 +2461,7 @@ void CHIPQueue::memCopy3D(void *Dst, size_t DPitch, size_t DSPitch,
 void CHIPQueue::memCopy3DAsync(void *Dst, size_t DPitch, size_t DSPitch,
                                const void *Src, size_t SPitch, size_t SSPitch,
                                size_t Width, size_t Height, size_t Depth) {
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1686,6 +2527,9 @@ CHIPEvent *CHIPQueue::RegisteredVarCopy(CHIPExecItem *ExecItem,
     if (HostPtr && AllocInfo->MemoryType == hipMemoryTypeManaged) {
       auto AllocInfo = AllocTracker->getAllocInfo(DevPtr);
 
+      // Only the last copy is returned to the caller for tracking.
+      if (RegisterVarEvent)
+        RegisterVarEvent->track();
       if (ExecState == MANAGED_MEM_STATE::PRE_KERNEL) {
         logDebug("A hipHostRegister argument was found. Appending a mem copy "
                  "Host {} -> Device {}",
@@ -1704,37 +2548,28 @@ CHIPEvent *CHIPQueue::RegisteredVarCopy(CHIPExecItem *ExecItem,
       updateLastEvent(RegisterVarEvent);
     }
   };
-  FuncInfo->visitClientArgs(ExecItem->getArgs(), ArgVisitor);
+  // std::cref() keeps the std::function wrapper from allocating.
+  FuncInfo->visitClientArgs(ExecItem->getArgs(), std::cref(ArgVisitor));
 
   return RegisterVarEvent;
 }
 
 void CHIPQueue::launch(CHIPExecItem *ExecItem) {
-  std::stringstream InfoStr;
-  InfoStr << "\nLaunching kernel " << ExecItem->getKernel()->getName() << "\n";
-  InfoStr << "GridDim: <" << ExecItem->getGrid().x << ", "
-          << ExecItem->getGrid().y << ", " << ExecItem->getGrid().z << ">";
-  InfoStr << " BlockDim: <" << ExecItem->getBlock().x << ", "
-          << ExecItem->getBlock().y << ", " << ExecItem->getBlock().z << ">\n";
-  InfoStr << "SharedMem: " << ExecItem->getSharedMem() << "\n";
-
-  const auto &FuncInfo = *ExecItem->getKernel()->getFuncInfo();
-  InfoStr << "NumArgs: " << FuncInfo.getNumKernelArgs() << "\n";
-  auto Visitor = [&](const SPVFuncInfo::KernelArg &Arg) -> void {
-    InfoStr << "Arg " << Arg.Index << ": " << Arg.getKindAsString() << " "
-            << Arg.Size << " " << Arg.Data << "\n";
-  };
-  FuncInfo.visitKernelArgs(ExecItem->getArgs(), Visitor);
-
-  // Making this log info since hipLaunchKernel doesn't know enough about args
-  logInfo("{}", InfoStr.str());
+  waitForSubmissions();
+  LOCK(LaunchMtx); // CHIPQueue::LaunchMtx
+  launchNoLock(ExecItem);
+}
 
-#ifdef ENFORCE_QUEUE_SYNC
-  ChipContext_->syncQueues(this);
-#endif
+void CHIPQueue::reserveArgSpillBuffer(CHIPArgSpillBuffer &SpillBuf,
+                                      const CHIPKernel &Kernel,
+                                      hipMemoryType MemType) {
+  if (!ArgSpillPool_)
+    ArgSpillPool_ = std::make_shared<CHIPArgSpillPool>(ChipContext_, MemType);
+  SpillBuf.reserveSpace(ArgSpillPool_, Kernel);
+}
 
-  auto TotalThreadsPerBlock =
-      ExecItem->getBlock().x * ExecItem->getBlock().y * ExecItem->getBlock().z;
+void CHIPQueue::checkBlockDim(dim3 BlockDim) {
+  auto TotalThreadsPerBlock = BlockDim.x * BlockDim.y * BlockDim.z;
   auto DeviceProps = getDevice()->getDeviceProps();
   auto MaxTotalThreadsPerBlock = DeviceProps.maxThreadsPerBlock;
 
@@ -1745,21 +2580,58 @@ void CHIPQueue::launch(CHIPExecItem *ExecItem) {
                           hipErrorLaunchFailure);
   }
 
-  if (ExecItem->getBlock().x > DeviceProps.maxThreadsDim[0] ||
-      ExecItem->getBlock().y > DeviceProps.maxThreadsDim[1] ||
-      ExecItem->getBlock().z > DeviceProps.maxThreadsDim[2]) {
+  if (BlockDim.x > DeviceProps.maxThreadsDim[0] ||
+      BlockDim.y > DeviceProps.maxThreadsDim[1] ||
+      BlockDim.z > DeviceProps.maxThreadsDim[2]) {
     logCritical(
         "Requested local size dimension ({}, {}, {}) exceeds max ({}, {}, {})",
-        ExecItem->getBlock().x, ExecItem->getBlock().y, ExecItem->getBlock().z,
-        DeviceProps.maxThreadsDim[0], DeviceProps.maxThreadsDim[1],
-        DeviceProps.maxThreadsDim[2]);
+        BlockDim.x, BlockDim.y, BlockDim.z, DeviceProps.maxThreadsDim[0],
+        DeviceProps.maxThreadsDim[1], DeviceProps.maxThreadsDim[2]);
     CHIPERR_LOG_AND_THROW("Requested local size exceeds HW max",
                           hipErrorLaunchFailure);
   }
+}
+
+void CHIPQueue::launchNoLock(CHIPExecItem *ExecItem) {
+  // Graph nodes create their exec items without a queue.
+  ExecItem->setQueue(this);
+
+  // Making this log info since hipLaunchKernel doesn't know enough about args.
+  // The message is only built when it is going to be emitted.
+  if (isLogLevelEnabled(spdlog::level::info)) {
+    std::stringstream InfoStr;
+    InfoStr << "\nLaunching kernel " << ExecItem->getKernel()->getName()
+            << "\n";
+    InfoStr << "GridDim: <" << ExecItem->getGrid().x << ", "
+            << ExecItem->getGrid().y << ", " << ExecItem->getGrid().z << ">";
+    InfoStr << " BlockDim: <" << ExecItem->getBlock().x << ", "
+            << ExecItem->getBlock().y << ", " << ExecItem->getBlock().z
+            << ">\n";
+    InfoStr << "SharedMem: " << ExecItem->getSharedMem() << "\n";
+
+    const auto &FuncInfo = *ExecItem->getKernel()->getFuncInfo();
+    InfoStr << "NumArgs: " << FuncInfo.getNumKernelArgs() << "\n";
+    auto Visitor = [&](const SPVFuncInfo::KernelArg &Arg) -> void {
+      InfoStr << "Arg " << Arg.Index << ": " << Arg.getKindAsString() << " "
+              << Arg.Size << " " << Arg.Data << "\n";
+    };
+    FuncInfo.visitKernelArgs(ExecItem->getArgs(), Visitor);
+
+    logInfo("{}", InfoStr.str());
+  }
+
+#ifdef ENFORCE_QUEUE_SYNC
+  ChipContext_->syncQueues(this);
+#endif
+
+  checkBlockDim(ExecItem->getBlock());
 
   auto RegisteredVarInEvent =
       RegisteredVarCopy(ExecItem, MANAGED_MEM_STATE::PRE_KERNEL);
   auto LaunchEvent = launchImpl(ExecItem);
+  // The spill space is reused once the launch is done, so an exec item
+  // recycled by launchKernel() can reserve again right away.
+  ExecItem->getArgSpillBuffer().release(LaunchEvent);
   auto RegisteredVarOutEvent =
       RegisteredVarCopy(ExecItem, MANAGED_MEM_STATE::POST_KERNEL);
 
@@ -1775,6 +2647,7 @@ void CHIPQueue::launch(CHIPExecItem *ExecItem) {
 
 CHIPEvent *
 CHIPQueue::enqueueBarrier(std::vector<CHIPEvent *> *EventsToWaitFor) {
+  waitForSubmissions();
   auto ChipEvent = enqueueBarrierImpl(EventsToWaitFor);
   ChipEvent->Msg = "enqueueBarrier";
   updateLastEvent(ChipEvent);
@@ -1782,6 +2655,7 @@ CHIPQueue::enqueueBarrier(std::vector<CHIPEvent *> *EventsToWaitFor) {
   return ChipEvent;
 }
 CHIPEvent *CHIPQueue::enqueueMarker() {
+  waitForSubmissions();
   auto ChipEvent = enqueueMarkerImpl();
   ChipEvent->Msg = "enqueueMarker";
   updateLastEvent(ChipEvent);
@@ -1790,6 +2664,7 @@ CHIPEvent *CHIPQueue::enqueueMarker() {
 }
 
 void CHIPQueue::memPrefetch(const void *Ptr, size_t Count) {
+  waitForSubmissions();
 #ifdef ENFORCE_QUEUE_SYNC
   ChipContext_->syncQueues(this);
 #endif
@@ -1803,14 +2678,42 @@ void CHIPQueue::memPrefetch(const void *Ptr, size_t Count) {
 void CHIPQueue::launchKernel(CHIPKernel *ChipKernel, dim3 NumBlocks,
                              dim3 DimBlocks, void **Args,
                              size_t SharedMemBytes) {
-  LOCK(Backend->BackendMtx); // Prevent the breakup of RegisteredVarCopy in&out
-  CHIPExecItem *ExecItem =
-      Backend->createCHIPExecItem(NumBlocks, DimBlocks, SharedMemBytes, this);
+  if (canSubmitAsync()) {
+    // Invalid launch configurations are reported by this call as usual.
+    checkBlockDim(DimBlocks);
+    std::unique_lock<std::mutex> SubmitLock;
+    if (CHIPSubmission *Submission = beginSubmission(SubmitLock)) {
+      Submission->Kernel = ChipKernel;
+      Submission->NumBlocks = NumBlocks;
+      Submission->DimBlocks = DimBlocks;
+      Submission->SharedMemBytes = SharedMemBytes;
+      // The caller may reuse the argument storage once this call returns.
+      ChipKernel->captureArgs(Args, Submission->ArgValues, Submission->Args);
+      commitSubmission();
+      return;
+    }
+  }
+  waitForSubmissions();
+
+  // Prevent the breakup of RegisteredVarCopy in&out. Launches on other queues
+  // may proceed in parallel since each queue binds arguments to its own
+  // kernel handle.
+  LOCK(LaunchMtx); // CHIPQueue::LaunchExecItem_
+  // The exec item is reused across launches on this queue so the steady state
+  // launch path does not allocate.
+  if (!LaunchExecItem_)
+    LaunchExecItem_.reset(Backend->createCHIPExecItem(NumBlocks, DimBlocks,
+                                                      SharedMemBytes, this));
+  else
+    LaunchExecItem_->reset(NumBlocks, DimBlocks, SharedMemBytes);
+
+  CHIPExecItem *ExecItem = LaunchExecItem_.get();
   ExecItem->setKernel(ChipKernel);
   ExecItem->copyArgs(Args);
-  ExecItem->setupAllArgs();
-  launch(ExecItem);
-  delete ExecItem;
+  launchNoLock(ExecItem);
+  // Drop the spill buffer reference now. The backend keeps it alive until the
+  // launch completes.
+  ExecItem->reset(NumBlocks, DimBlocks, SharedMemBytes);
 }
 
 ///////// End Enqueue Operations //////////
@@ -1827,6 +2730,7 @@ CHIPDevice *CHIPQueue::getDevice() {
 CHIPQueueFlags CHIPQueue::getFlags() { return QueueFlags_; }
 int CHIPQueue::getPriority() { return Priority_; }
 void CHIPQueue::addCallback(hipStreamCallback_t Callback, void *UserData) {
+  waitForSubmissions();
   CHIPCallbackData *Callbackdata =
       Backend->createCallbackData(Callback, UserData, this);
 
@@ -1834,6 +2738,7 @@ void CHIPQueue::addCallback(hipStreamCallback_t Callback, void *UserData) {
     LOCK(Backend->CallbackQueueMtx); // CHIPBackend::CallbackQueue
     Backend->CallbackQueue.push(Callbackdata);
   }
+  Backend->CallbackQueueCond.notify_one();
 
   return;
 }
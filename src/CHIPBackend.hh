@@ -35,8 +35,17 @@
 #ifndef CHIP_BACKEND_H
 #define CHIP_BACKEND_H
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <shared_mutex>
+#include <thread>
+
 #include "spirv.hh"
 #include "common.hh"
+#include "hip/hip_interop.h"
 #include "hip/hip_runtime_api.h"
 #include "hip/spirv_hip.hh"
 
@@ -194,6 +203,7 @@ class CHIPQueueFlags {
   unsigned int FlagsRaw_;
   bool Default_ = true;
   bool NonBlocking_ = false;
+  int EngineAffinity_ = -1;
 
 public:
   CHIPQueueFlags() : CHIPQueueFlags(hipStreamDefault) {}
@@ -209,6 +219,13 @@ public:
       FlagsRaw = FlagsRaw & (~hipStreamNonBlocking);
     }
 
+    if (FlagsRaw & hipStreamEngineAffinityMask) {
+      EngineAffinity_ = int((FlagsRaw & hipStreamEngineAffinityMask) >>
+                            hipStreamEngineAffinityShift) -
+                        1;
+      FlagsRaw = FlagsRaw & (~hipStreamEngineAffinityMask);
+    }
+
     if (FlagsRaw > 0)
       CHIPERR_LOG_AND_THROW("Invalid CHIPQueueFlags", hipErrorInvalidValue);
   }
@@ -216,6 +233,13 @@ public:
   bool isDefault() { return Default_; }
   bool isNonBlocking() { return NonBlocking_; }
   bool isBlocking() { return !NonBlocking_; }
+  /// The hardware queue index requested with hipStreamEngineAffinity(), or
+  /// -1 to let the backend place the queue.
+  int getEngineAffinity() { return EngineAffinity_; }
+  /// The flags without the engine affinity.
+  CHIPQueueFlags withoutEngineAffinity() {
+    return CHIPQueueFlags(FlagsRaw_ & ~hipStreamEngineAffinityMask);
+  }
   unsigned int getRaw() { return FlagsRaw_; }
 };
 
@@ -360,6 +384,140 @@ public:
   }
 };
 
+/**
+ * @brief A fixed capacity, lock-free ring buffer for one producer and one
+ * consumer thread.
+ */
+template <typename T, size_t Capacity> class CHIPSPSCRing {
+  static_assert((Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+  std::unique_ptr<T[]> Slots_;
+  /// Index of the next slot to pop. Written by the consumer only.
+  alignas(64) std::atomic<size_t> Head_{0};
+  /// Index of the next slot to push. Written by the producer only.
+  alignas(64) std::atomic<size_t> Tail_{0};
+
+public:
+  CHIPSPSCRing() : Slots_(new T[Capacity]) {}
+
+  /// Get the slot of the next item to push, or null if the ring is full.
+  /// The slots are reused so the slot holds whatever its last item left
+  /// there. Producer only.
+  T *back() {
+    size_t Tail = Tail_.load(std::memory_order_relaxed);
+    if (Tail - Head_.load(std::memory_order_acquire) == Capacity)
+      return nullptr;
+    return &Slots_[Tail & (Capacity - 1)];
+  }
+
+  /// Publish the item filled in the slot returned by back(). Producer only.
+  void push() { Tail_.store(Tail_.load(std::memory_order_relaxed) + 1); }
+
+  /// Get the oldest item, or null if the ring is empty. Consumer only.
+  T *front() {
+    size_t Head = Head_.load(std::memory_order_relaxed);
+    if (Head == Tail_.load())
+      return nullptr;
+    return &Slots_[Head & (Capacity - 1)];
+  }
+
+  /// Hand the slot of the oldest item back to the producer. Consumer only.
+  void pop() {
+    Head_.store(Head_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  bool empty() const { return Head_.load() == Tail_.load(); }
+};
+
+/**
+ * @brief A per-device thread which drains the operations the device's
+ * queues defer to it (see CHIPQueue::submitAsync()) into the backend.
+ *
+ * Enabled with CHIP_ASYNC_SUBMIT=1.
+ */
+class CHIPSubmissionWorker {
+  /// The context the deferred operations are executed in.
+  CHIPContext *ChipContext_;
+  std::thread Thread_;
+  /// Guards Queues_. Held by the worker while it drains the queues so that
+  /// a queue can't be detached in the middle of it.
+  std::mutex QueuesMtx_;
+  std::vector<CHIPQueue *> Queues_;
+
+  std::mutex SleepMtx_;
+  std::condition_variable WakeCV_;
+  std::atomic<bool> Sleeping_{false};
+  std::atomic<bool> Stop_{false};
+
+  inline static thread_local bool IsWorkerThread_ = false;
+
+  void run();
+
+public:
+  CHIPSubmissionWorker(CHIPContext *ChipContext);
+  ~CHIPSubmissionWorker();
+
+  void addQueue(CHIPQueue *ChipQueue);
+  void removeQueue(CHIPQueue *ChipQueue);
+
+  /// Wake the worker up if it is sleeping.
+  void notify() {
+    if (Sleeping_) {
+      LOCK(SleepMtx_); // CHIPSubmissionWorker::Sleeping_
+      WakeCV_.notify_one();
+    }
+  }
+
+  /// Return true if called from a submission worker.
+  static bool isWorkerThread() { return IsWorkerThread_; }
+};
+
+/**
+ * @brief A set of live queue handles for validating the stream arguments of
+ * API calls.
+ *
+ * An open-addressing hash table guarded by a sequence lock. Lookups do not
+ * lock nor allocate: they probe the table with plain atomic loads and retry
+ * if a writer modified the table meanwhile. Writers are serialized by a
+ * mutex. Outgrown tables are kept until the registry is destroyed as a
+ * reader may still be probing them.
+ */
+class CHIPQueueRegistry {
+  struct Table {
+    size_t Mask;
+    std::unique_ptr<std::atomic<CHIPQueue *>[]> Slots;
+    Table(size_t Capacity);
+  };
+
+  std::mutex WriteMtx_;
+  /// Odd while a writer is modifying the table.
+  std::atomic<size_t> Seq_{0};
+  std::atomic<Table *> Current_;
+  std::vector<std::unique_ptr<Table>> Tables_;
+  size_t Size_ = 0;
+
+  static size_t hash(const CHIPQueue *ChipQueue) {
+    size_t H = (reinterpret_cast<uintptr_t>(ChipQueue) >> 4) *
+               0x9E3779B97F4A7C15ull;
+    return H ^ (H >> 32);
+  }
+  void beginWrite();
+  void endWrite();
+  void insertNoLock(Table &T, CHIPQueue *ChipQueue);
+
+public:
+  CHIPQueueRegistry();
+
+  /// Return true if the queue is in the registry.
+  bool contains(const CHIPQueue *ChipQueue) const;
+  /// Add a queue. Returns false if it was already present.
+  bool insert(CHIPQueue *ChipQueue);
+  /// Remove a queue. Returns false if it was not present.
+  bool erase(const CHIPQueue *ChipQueue);
+  void clear();
+};
+
 class CHIPTexture {
   /// Resource description used to create this texture.
   hipResourceDesc ResourceDesc;
@@ -581,16 +739,83 @@ public:
   void markHasInitializer(bool State = true) { HasInitializer_ = State; }
 };
 
+/**
+ * @brief Host-visible progress of a queue. Each command which becomes the
+ * last event of the queue takes the next sequence number and the number of
+ * the newest command seen complete is published as work retires. Since the
+ * queues are in-order, every command up to that number is also complete, so
+ * queries need just two atomic loads. Backends which put several commands
+ * in one submission must keep them ordered for this to hold (Level Zero
+ * separates batched commands with barriers).
+ *
+ * Owned by the device so that the events recorded on a destroyed queue can
+ * still be queried. The timeline of a destroyed queue is reused only once
+ * it is idle, and its numbering continues, so the old events stay done.
+ */
+class CHIPQueueTimeline {
+  std::atomic<size_t> Submitted_{0};
+  std::atomic<size_t> Completed_{0};
+
+public:
+  /// Return the sequence number of a newly submitted command.
+  size_t submit() { return ++Submitted_; }
+  size_t getSubmitted() const {
+    return Submitted_.load(std::memory_order_acquire);
+  }
+
+  /// Record that the command 'Seq' and those before it are complete.
+  void complete(size_t Seq) {
+    size_t Old = Completed_.load(std::memory_order_relaxed);
+    while (Old < Seq && !Completed_.compare_exchange_weak(
+                            Old, Seq, std::memory_order_release,
+                            std::memory_order_relaxed))
+      ;
+  }
+  bool isComplete(size_t Seq) const {
+    return Completed_.load(std::memory_order_acquire) >= Seq;
+  }
+  /// Return true if all the commands submitted so far are complete.
+  bool isIdle() const { return isComplete(getSubmitted()); }
+};
+
 class CHIPEvent : public ihipEvent_t {
 protected:
   bool UserEvent_ = false;
   bool TrackCalled_ = false;
-  event_status_e EventStatus_;
+  std::atomic<event_status_e> EventStatus_;
   CHIPEventFlags Flags_;
   std::vector<CHIPEvent *> DependsOnList;
 
+  /// The timeline of the queue this event was last submitted to and the
+  /// sequence number of the event on it. Written under EventMtx. The version
+  /// is odd while the pair is changed so that the lock-free readers never
+  /// pair the sequence number with the wrong timeline.
+  std::atomic<unsigned> TimelineVersion_{0};
+  std::atomic<CHIPQueueTimeline *> Timeline_{nullptr};
+  std::atomic<size_t> TimelineSeq_{0};
+
+  /// Read the timeline point. Return false if it changed during the read.
+  bool loadTimelinePoint(CHIPQueueTimeline *&Timeline, size_t &Seq) const {
+    unsigned Version = TimelineVersion_;
+    if (Version & 1)
+      return false;
+    Timeline = Timeline_;
+    Seq = TimelineSeq_;
+    return TimelineVersion_ == Version;
+  }
+
+  /// Mark the event complete and advance the timeline of its queue.
+  void setRecorded() {
+    EventStatus_ = EVENT_STATUS_RECORDED;
+    // If the point is being changed, setTimelinePoint() completes it.
+    CHIPQueueTimeline *Timeline;
+    size_t Seq;
+    if (loadTimelinePoint(Timeline, Seq) && Timeline)
+      Timeline->complete(Seq);
+  }
+
   // reference count
-  size_t *Refc_;
+  std::atomic<size_t> Refc_{0};
 
   /**
    * @brief Events are always created with a context
@@ -605,17 +830,26 @@ protected:
    */
   CHIPEvent() = default;
 
+  /// Called by decreaseRefCount() when the last reference is dropped.
+  virtual void released() {}
+
 public:
   bool isUserEvent() { return UserEvent_; }
-  void addDependency(CHIPEvent *Event) { DependsOnList.push_back(Event); }
+  void addDependency(CHIPEvent *Event) {
+    LOCK(EventMtx); // CHIPEvent::DependsOnList
+    DependsOnList.push_back(Event);
+  }
+  /// Drop the references to the events this one depended on.
   void releaseDependencies();
   void track();
   CHIPEventFlags getFlags() { return Flags_; }
   std::mutex EventMtx;
   std::string Msg;
-  size_t getCHIPRefc();
-  virtual void decreaseRefCount(std::string Reason);
-  virtual void increaseRefCount(std::string Reason);
+  size_t getCHIPRefc() { return Refc_.load(std::memory_order_acquire); }
+  /// Change the reference count. The reason is only logged in builds with
+  /// TRACE_EVENT_REFCOUNTS.
+  virtual void decreaseRefCount(const char *Reason);
+  virtual void increaseRefCount(const char *Reason);
   virtual ~CHIPEvent() = default;
   // Optionally provide a field for origin of this event
   /**
@@ -658,6 +892,37 @@ public:
    */
   bool isFinished() { return (EventStatus_ == EVENT_STATUS_RECORDED); }
 
+  /**
+   * @brief Place the event at the given point of a queue timeline. The
+   * event is done once the timeline completes 'Seq'.
+   */
+  void setTimelinePoint(CHIPQueueTimeline *Timeline, size_t Seq) {
+    LOCK(EventMtx); // CHIPEvent::Timeline_
+    unsigned Version = TimelineVersion_;
+    TimelineVersion_ = Version + 1;
+    Timeline_ = Timeline;
+    TimelineSeq_ = Seq;
+    TimelineVersion_ = Version + 2;
+    // A concurrent setRecorded() may have missed the new point.
+    if (Timeline && isFinished())
+      Timeline->complete(Seq);
+  }
+  void clearTimelinePoint() { setTimelinePoint(nullptr, 0); }
+
+  /**
+   * @brief Return true if the event is known to be complete, either by its
+   * own status or by the progress of its queue. Does not query the driver
+   * nor lock, so a false result may be stale.
+   */
+  bool isDone() {
+    if (isFinished())
+      return true;
+    CHIPQueueTimeline *Timeline;
+    size_t Seq;
+    return loadTimelinePoint(Timeline, Seq) && Timeline &&
+           EventStatus_ == EVENT_STATUS_RECORDING && Timeline->isComplete(Seq);
+  }
+
   /**
    * @brief Get the Event Status object
    *
@@ -708,6 +973,13 @@ public:
    *
    */
   virtual void hostSignal() = 0;
+
+  using ActionFn = std::function<void()>;
+  /**
+   * @brief Bind an action to be executed on the host once the recording of
+   * this event has finished. Must be called before track().
+   */
+  virtual void addAction(ActionFn Action) = 0;
 };
 
 class CHIPProgram {
@@ -930,6 +1202,42 @@ public:
   const SPVModule &getSourceModule() const { return *Src_; }
 };
 
+/**
+ * @brief Shadow copy of the argument values last bound to a native kernel
+ * handle. Used for eliding redundant argument binding calls.
+ */
+class CHIPArgShadow {
+  std::vector<char> Values_;
+  std::vector<size_t> Offsets_;
+  std::vector<size_t> Capacity_;
+  /// Size of the bound value or NotBound.
+  std::vector<size_t> Sizes_;
+  /// True if the value was bound as a nullptr.
+  std::vector<char> IsNull_;
+  static constexpr size_t NotBound = ~size_t(0);
+
+public:
+  CHIPArgShadow() = default;
+  CHIPArgShadow(const std::vector<SPVArgPlanEntry> &ArgPlan);
+
+  bool isBound(unsigned Index, size_t Size, const void *Value) const;
+  void record(unsigned Index, size_t Size, const void *Value);
+  void invalidate();
+};
+
+/**
+ * @brief A copy of the client arguments of a kernel launch. Used when the
+ * launch is executed after the caller's argument storage may have changed.
+ */
+class CHIPCapturedArgs {
+  std::vector<char> Values_;
+  std::vector<void *> Args_;
+
+public:
+  CHIPCapturedArgs(const CHIPKernel &Kernel, void **Args);
+  void **getArgs() { return Args_.data(); }
+};
+
 /**
  * @brief Contains information about the function on the host and device
  */
@@ -950,9 +1258,64 @@ protected:
 
   SPVFuncInfo *FuncInfo_;
 
+  /// Argument binding plan built from FuncInfo_ at construction.
+  std::vector<SPVArgPlanEntry> ArgPlan_;
+  /// Size of the argument spill buffer needed by the kernel.
+  size_t ArgSpillSize_ = 0;
+  /// Offsets and sizes of the client argument values, by client argument
+  /// index, in the storage of captureArgs().
+  std::vector<size_t> CaptureOffsets_;
+  std::vector<size_t> CaptureSizes_;
+  size_t CaptureSize_ = 0;
+
+  std::atomic<size_t> NumArgBindings_{0};
+  std::atomic<size_t> NumArgBindingsSkipped_{0};
+
 public:
   virtual ~CHIPKernel();
 
+  /**
+   * @brief Check whether the argument at 'Index' was last bound to the native
+   * kernel handle, which 'Shadow' tracks, with the same size and value.
+   *
+   * The caller may skip the binding call if this returns true. Otherwise, the
+   * caller should call recordArgBinding() after a successful binding.
+   */
+  bool isArgBound(const CHIPArgShadow &Shadow, unsigned Index, size_t Size,
+                  const void *Value);
+
+  /**
+   * @brief Record the argument value bound to the native kernel handle.
+   */
+  void recordArgBinding(CHIPArgShadow &Shadow, unsigned Index, size_t Size,
+                        const void *Value) {
+    Shadow.record(Index, Size, Value);
+  }
+
+  /// Number of argument binding requests and how many of them were skipped.
+  size_t getNumArgBindings() const { return NumArgBindings_; }
+  size_t getNumArgBindingsSkipped() const { return NumArgBindingsSkipped_; }
+
+  /**
+   * @brief Get the precomputed argument binding plan (in kernel argument
+   * order).
+   */
+  const std::vector<SPVArgPlanEntry> &getArgPlan() const { return ArgPlan_; }
+
+  /**
+   * @brief Get the size of the argument spill buffer the kernel needs. Zero
+   * if the kernel does not have by-reference arguments.
+   */
+  size_t getArgSpillSize() const { return ArgSpillSize_; }
+
+  /**
+   * @brief Copy the client argument values to Values and point ArgPtrs to
+   * the copies. Does not allocate if the vectors have the capacity left by
+   * an earlier capture.
+   */
+  void captureArgs(void **Args, std::vector<char> &Values,
+                   std::vector<void *> &ArgPtrs) const;
+
   /**
    * @brief Get the Name object
    *
@@ -1011,30 +1374,130 @@ public:
    */
   virtual CHIPModule *getModule() = 0;
   virtual const CHIPModule *getModule() const = 0;
+
+  /**
+   * @brief Release the kernel handle created for launches on the queue, if
+   * any. Called when the queue is destroyed.
+   */
+  virtual void releaseHandle(const CHIPQueue *ChipQueue) {}
 };
 
-class CHIPArgSpillBuffer {
-  CHIPContext *Ctx_; ///< A context to allocate device space from.
+/**
+ * @brief A ring allocator for argument spill buffers of a queue.
+ *
+ * The device memory is allocated once. A slice is handed out for each launch
+ * with spilled arguments and returned to the ring with the launch's event.
+ * Slices are reclaimed in the order they were handed out once their events
+ * are done, so the launches need no completion callbacks.
+ */
+class CHIPArgSpillPool {
+  CHIPContext *Ctx_;
+  /// True if the device buffer can be written by the host directly.
+  bool HostVisible_;
+  size_t Capacity_;
+  /// Staging buffer for the argument values if !HostVisible_.
   std::unique_ptr<char[]> HostBuffer_;
   char *DeviceBuffer_ = nullptr;
-  std::map<size_t, size_t> ArgIndexToOffset_;
+
+  struct Slice {
+    size_t Start; ///< Includes the padding skipped at the end of the ring.
+    size_t End;
+    bool Released;
+    /// The launch reading the slice. Holds a reference.
+    CHIPEvent *Event;
+  };
+  /// A spill buffer allocated outside the ring, freed once Event is done.
+  struct Detached {
+    std::unique_ptr<char[]> HostBuffer;
+    char *DeviceBuffer;
+    CHIPEvent *Event; ///< Holds a reference.
+  };
+  std::mutex PoolMtx_;
+  /// Slices in use in allocation order. Offsets increase monotonically and
+  /// are mapped to the ring modulo Capacity_.
+  std::deque<Slice> InUse_;
+  size_t Tail_ = 0;
+  std::deque<Detached> Detached_;
+
+  /// Pop the released slices whose launches are done. Queries the driver
+  /// for the oldest pending launch if 'Query' is set.
+  void reclaim(bool Query);
+  void reclaimDetached();
+
+public:
+  static constexpr size_t DefaultCapacity = 1 << 20;
+
+  CHIPArgSpillPool(CHIPContext *Ctx, hipMemoryType MemType,
+                   size_t Capacity = DefaultCapacity);
+  ~CHIPArgSpillPool();
+
+  /**
+   * @brief Take a slice of 'Size' bytes from the ring.
+   *
+   * @return false if the ring does not have enough free space.
+   */
+  bool acquire(size_t Size, char *&HostPtr, char *&DevicePtr, size_t &SliceEnd);
+  /**
+   * @brief Return a slice identified by its end offset to the ring. The slice
+   * is reused once 'Event', if not null, is done.
+   */
+  void release(size_t SliceEnd, CHIPEvent *Event);
+  /// Free a spill buffer allocated outside the ring once 'Event', if not
+  /// null, is done.
+  void release(std::unique_ptr<char[]> HostBuffer, char *DeviceBuffer,
+               CHIPEvent *Event);
+  CHIPContext *getContext() const { return Ctx_; }
+  bool isHostVisible() const { return HostVisible_; }
+};
+
+/**
+ * @brief Spilled argument values of a launch. Lives in the exec item and is
+ * reserved from the queue's CHIPArgSpillPool for each launch.
+ */
+class CHIPArgSpillBuffer {
+  /// The pool the space is reserved from. Null if nothing is reserved.
+  std::shared_ptr<CHIPArgSpillPool> Pool_;
+  /// True if the space is a slice of the ring rather than a separate
+  /// allocation.
+  bool InRing_ = false;
+  size_t SliceEnd_ = 0;
+  std::unique_ptr<char[]> OwnHostBuffer_;
+  char *HostBuffer_ = nullptr;
+  char *DeviceBuffer_ = nullptr;
   size_t Size_ = 0;
 
 public:
-  CHIPArgSpillBuffer() = delete;
-  CHIPArgSpillBuffer(CHIPContext *Ctx) : Ctx_(Ctx) {}
-  ~CHIPArgSpillBuffer();
-  void computeAndReserveSpace(const SPVFuncInfo &KernelInfo);
-  void *allocate(const SPVFuncInfo::Arg &Arg);
+  // FIXME: Extract alignment requirement for the argument values
+  //        from SPIR-V, store it in FuncInfo and use it instead. Using
+  //        now an arbitrarily chosen value (sizeof(double4)).
+  static constexpr size_t ArgAlignment = 32;
+
+  CHIPArgSpillBuffer() = default;
+  CHIPArgSpillBuffer(const CHIPArgSpillBuffer &) = delete;
+  ~CHIPArgSpillBuffer() { release(nullptr); }
+  /// Reserve space for the spilled arguments of 'Kernel'. A previous
+  /// reservation is released first.
+  void reserveSpace(std::shared_ptr<CHIPArgSpillPool> Pool,
+                    const CHIPKernel &Kernel);
+  /**
+   * @brief Hand the reserved space back to its pool. The pool reuses it once
+   * 'LaunchEvent', if not null, is done.
+   */
+  void release(CHIPEvent *LaunchEvent);
+  bool isReserved() const { return Pool_ != nullptr; }
+  void *allocate(const SPVArgPlanEntry &Arg, const void *ArgData);
   size_t getSize() const { return Size_; }
   const void *getHostBuffer() const {
-    assert(HostBuffer_.get());
-    return HostBuffer_.get();
+    assert(HostBuffer_);
+    return HostBuffer_;
   }
   void *getDeviceBuffer() {
     assert(DeviceBuffer_);
     return DeviceBuffer_;
   }
+  /// Return true if the host buffer must be copied to the device buffer
+  /// before the launch.
+  bool needsUpload() const { return HostBuffer_ != DeviceBuffer_; }
 };
 
 /**
@@ -1047,7 +1510,6 @@ public:
  */
 class CHIPExecItem {
 protected:
-  bool ArgsSetup = false;
   size_t SharedMem_;
 
   dim3 GridDim_;
@@ -1058,10 +1520,17 @@ protected:
 
   std::vector<void *> Args_;
 
-  std::shared_ptr<CHIPArgSpillBuffer> ArgSpillBuffer_;
+  CHIPArgSpillBuffer ArgSpillBuffer_;
 
 public:
   void copyArgs(void **Args);
+
+  /**
+   * @brief Prepare the exec item for another launch. Clears the arguments
+   * (keeping their storage) and releases the argument spill buffer.
+   */
+  void reset(dim3 GridDim, dim3 BlockDim, size_t SharedMem);
+
   void setQueue(CHIPQueue *Queue) { ChipQueue_ = Queue; }
   std::mutex ExecItemMtx;
   size_t getNumArgs() {
@@ -1149,14 +1618,15 @@ public:
    * kernel launch API)
    * Or after hipLaunchKernel (new HIP kernel launch API)
    *
+   * The arguments are bound to the kernel handle of the exec item's queue.
+   * Called by CHIPQueue::launchImpl() for every launch while the queue's
+   * LaunchMtx is held.
    */
   virtual void setupAllArgs() = 0;
 
   void setKernel(CHIPKernel *Kernel) { this->ChipKernel_ = Kernel; }
 
-  std::shared_ptr<CHIPArgSpillBuffer> getArgSpillBuffer() const {
-    return ArgSpillBuffer_;
-  };
+  CHIPArgSpillBuffer &getArgSpillBuffer() { return ArgSpillBuffer_; }
 };
 
 /**
@@ -1194,6 +1664,49 @@ protected:
 
   int Idx_ = -1; // Initialized with a value indicating unset ID.
 
+  /// Drains operations deferred by the device's queues. Created on first
+  /// use.
+  std::unique_ptr<CHIPSubmissionWorker> SubmissionWorker_;
+  std::once_flag SubmissionWorkerCreated_;
+
+  /// A device side abort flag being copied to a host USM slot. See
+  /// watchAbortFetch().
+  struct AbortFetch {
+    size_t Id;
+    CHIPModule *Module;
+    std::atomic<int32_t> *Flag;
+    CHIPEvent *Event; // Holds a reference.
+  };
+
+  /// Modules using abort() and the fetches of their abort flags.
+  std::mutex AbortWatchMtx_;
+  std::vector<CHIPModule *> AbortWatchedModules_;
+  std::vector<AbortFetch> AbortFetches_;
+  size_t NextAbortFetchId_ = 0;
+  /// Watched modules whose abort was ignored. See takeAbortedModules().
+  std::vector<CHIPModule *> AbortedModules_;
+  /// Host USM blocks of abort flag slots and the unused slots.
+  std::vector<void *> AbortFlagBlocks_;
+  std::vector<std::atomic<int32_t> *> FreeAbortFlags_;
+
+  /// Finish the abort flag fetches for which IsDone returns true. Aborts the
+  /// process if a fetched flag is set, unless aborts are ignored.
+  void finishAbortFetches(const std::function<bool(AbortFetch &)> &IsDone);
+  /// Called when the fetch with the given id has completed.
+  void endAbortFetch(size_t Id);
+
+  /// The user created queues in ChipQueues_ for lock-free validation.
+  CHIPQueueRegistry QueueRegistry_;
+
+  /// Flags set with hipSetDeviceFlags().
+  std::atomic<unsigned> Flags_{hipDeviceScheduleAuto};
+
+  /// The timelines of the queues, kept for the lifetime of the device since
+  /// events refer to them without a reference. Guarded by TimelinesMtx_.
+  std::vector<std::unique_ptr<CHIPQueueTimeline>> Timelines_;
+  std::vector<CHIPQueueTimeline *> FreeTimelines_;
+  std::mutex TimelinesMtx_;
+
   // only callable from derived classes, because we need to call also init()
   CHIPDevice(CHIPContext *Ctx, int DeviceIdx);
   // initializer. may call virtual methods
@@ -1204,9 +1717,20 @@ public:
   hipDeviceProp_t getDeviceProps() { return HipDeviceProps_; }
   std::mutex DeviceVarMtx;
   std::mutex DeviceMtx;
+  /// Held shared while queues are used outside DeviceMtx and exclusively
+  /// while a queue is deleted. Taken after DeviceMtx, if both are taken.
+  std::shared_mutex QueueDeleteMtx;
 
   std::vector<CHIPQueue *> getQueuesNoLock() { return ChipQueues_; }
 
+  /**
+   * @brief Return true if the queue is a live user created queue of the
+   * device. Does not take DeviceMtx.
+   */
+  bool hasQueue(const CHIPQueue *ChipQueue) const {
+    return QueueRegistry_.contains(ChipQueue);
+  }
+
   CHIPQueue *LegacyDefaultQueue;
   inline static thread_local std::unique_ptr<CHIPQueue> PerThreadDefaultQueue;
 
@@ -1239,6 +1763,86 @@ public:
    */
   CHIPQueue *getDefaultQueue();
 
+  /// Return a timeline for a new queue.
+  CHIPQueueTimeline *acquireTimeline();
+  /// Give back the timeline of a destroyed queue. Reused once idle.
+  void releaseTimeline(CHIPQueueTimeline *Timeline);
+
+  /**
+   * @brief Get the submission worker of the device. Starts the worker on the
+   * first call.
+   */
+  CHIPSubmissionWorker *getSubmissionWorker();
+
+  /**
+   * @brief Wait for the work submitted to the queues of the device so far.
+   *
+   * The last events of the queues are collected under DeviceMtx and waited
+   * for together after it has been released. The device printf output of
+   * the queues is then drained without waiting for work submitted since.
+   */
+  void waitForQueues();
+
+  /**
+   * @brief Wait until all the events have finished. The events must have
+   * been submitted.
+   */
+  virtual void waitForEvents(const std::vector<CHIPEvent *> &Events);
+
+  unsigned getFlags() const { return Flags_; }
+  void setFlags(unsigned Flags) { Flags_ = Flags; }
+  /// Return the hipDeviceSchedule* flag in effect. hipDeviceScheduleAuto
+  /// is overridden by CHIP_SYNC_POLICY.
+  unsigned getScheduleFlag() const {
+    unsigned Schedule = Flags_ & hipDeviceScheduleMask;
+    return Schedule == hipDeviceScheduleAuto ? CHIPDefaultScheduleFlag
+                                             : Schedule;
+  }
+
+  /// How long hipDeviceScheduleAuto polls before it starts yielding and how
+  /// long it polls and yields before it blocks.
+  static constexpr std::chrono::microseconds SyncSpinTime{20};
+  static constexpr std::chrono::microseconds SyncYieldTime{500};
+
+  /**
+   * @brief Wait for the device until IsDone() returns true, as directed by
+   * the scheduling flag of the device.
+   *
+   * hipDeviceScheduleSpin polls IsDone(). hipDeviceScheduleYield yields
+   * the CPU between the polls. hipDeviceScheduleBlockingSync calls Block()
+   * which must block until done. hipDeviceScheduleAuto polls, then polls
+   * and yields, each for a bounded time, and then blocks.
+   */
+  template <typename IsDoneFn, typename BlockFn>
+  void synchronize(IsDoneFn IsDone, BlockFn Block) {
+    switch (getScheduleFlag()) {
+    case hipDeviceScheduleBlockingSync:
+      Block();
+      return;
+    case hipDeviceScheduleSpin:
+      while (!IsDone())
+        ;
+      return;
+    case hipDeviceScheduleYield:
+      while (!IsDone())
+        std::this_thread::yield();
+      return;
+    default:
+      break;
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    while (!IsDone()) {
+      auto Waited = std::chrono::steady_clock::now() - Start;
+      if (Waited >= SyncSpinTime + SyncYieldTime) {
+        Block();
+        return;
+      }
+      if (Waited >= SyncSpinTime)
+        std::this_thread::yield();
+    }
+  }
+
   /**
    * @brief Create a Queue object
    *
@@ -1290,6 +1894,12 @@ public:
    */
   std::vector<CHIPKernel *> getKernels();
 
+  /**
+   * @brief Release the kernel handles created for launches on the queue.
+   * Called by the queue's destructor after its work has completed.
+   */
+  void releaseKernelHandles(const CHIPQueue *ChipQueue);
+
   ModuleState getModuleState() const {
     ModuleState State;
     State.SrcModToCompiledMod_ = SrcModToCompiledMod_;
@@ -1349,6 +1959,8 @@ public:
    * @return std::vector<CHIPQueue*>
    */
   std::vector<CHIPQueue *> &getQueues();
+  /// Forget the user created queues without destroying them.
+  void clearQueues();
 
   /**
    * @brief Remove a queue from this device's queue vector
@@ -1499,6 +2111,32 @@ public:
 
   void eraseModule(CHIPModule *Module);
 
+  /// Get a host USM slot for fetching an abort flag.
+  std::atomic<int32_t> *acquireAbortFlag();
+
+  /**
+   * @brief Watch the copy of the module's abort flag to Flag, from
+   * acquireAbortFlag(), which Event signals. The flag is checked as soon as
+   * the event has finished: the process is aborted if the flag is set,
+   * unless CHIP_HOST_IGNORES_DEVICE_ABORT is set, in which case the module
+   * is reported by takeAbortedModules().
+   */
+  void watchAbortFetch(CHIPModule *Module, std::atomic<int32_t> *Flag,
+                       CHIPEvent *Event);
+
+  /// Check the abort flag fetches which have finished without waiting for
+  /// their completion to be noticed.
+  void checkAbortFetches();
+
+  /**
+   * @brief Wait for and check the abort flag fetches of the module, or of
+   * all modules if Module is null.
+   */
+  void waitForAbortFetches(CHIPModule *Module);
+
+  /// Take the modules whose abort has been ignored.
+  std::vector<CHIPModule *> takeAbortedModules();
+
   virtual CHIPTexture *
   createTexture(const hipResourceDesc *ResDesc, const hipTextureDesc *TexDesc,
                 const struct hipResourceViewDesc *ResViewDesc) = 0;
@@ -1533,6 +2171,10 @@ protected:
 
   unsigned int Flags_;
 
+  /// Statistics of syncQueues().
+  std::atomic<size_t> NumSyncBarriers_{0};
+  std::atomic<size_t> NumSyncBarriersElided_{0};
+
   /**
    * @brief Construct a new CHIPContext object
    *
@@ -1549,6 +2191,11 @@ public:
    */
   virtual ~CHIPContext();
 
+  /**
+   * @brief Make the target queue wait for the queues it implicitly
+   * synchronizes with. The barrier is elided if the target has already
+   * waited for all the work submitted to them.
+   */
   virtual void syncQueues(CHIPQueue *TargetQueue);
 
   void setDevice(CHIPDevice *Device) { ChipDevice_ = Device; }
@@ -1699,11 +2346,6 @@ protected:
   std::shared_ptr<spdlog::logger> Logger;
 
 public:
-#ifdef DUBIOUS_LOCKS
-  std::mutex DubiousLockOpenCL;
-  std::mutex DubiousLockLevel0;
-#endif
-
   virtual CHIPExecItem *createCHIPExecItem(dim3 GirdDim, dim3 BlockDim,
                                            size_t SharedMem,
                                            hipStream_t ChipQueue) = 0;
@@ -1713,10 +2355,15 @@ public:
   std::mutex QueueCreateDestroyMtx;
   mutable std::mutex BackendMtx;
   std::mutex CallbackQueueMtx;
+  /// Events tracked since the stale event monitor last collected them.
   std::vector<CHIPEvent *> Events;
   std::mutex EventsMtx;
+  /// Notified when an event is tracked.
+  std::condition_variable EventsCond;
 
   std::queue<CHIPCallbackData *> CallbackQueue;
+  /// Notified when a callback is added to CallbackQueue.
+  std::condition_variable CallbackQueueCond;
 
   // Adds -std=c++17 requirement
   inline static thread_local hipError_t TlsLastError;
@@ -1967,6 +2614,70 @@ protected:
    * for enforcing proper queue syncronization as per HIP/CUDA API. */
   CHIPEvent *LastEvent_ = nullptr;
 
+  /// Unique id of the queue. Unlike the address, never reused.
+  const uint64_t Uid_;
+  inline static std::atomic<uint64_t> NextUid_{0};
+  /// Incremented when a command is submitted to the queue (see
+  /// updateLastEvent()).
+  std::atomic<size_t> SubmitEpoch_{0};
+  /// Completion progress of the commands of the queue, for query(). Owned
+  /// by the device.
+  CHIPQueueTimeline *Timeline_;
+  /// The submission epochs of the other queues this queue has waited on in
+  /// CHIPContext::syncQueues(), keyed by queue uid. Guarded by
+  /// CHIPDevice::DeviceMtx.
+  std::unordered_map<uint64_t, size_t> SyncedEpochs_;
+
+  /// Exec item recycled by launchKernel() to avoid per-launch allocations.
+  std::unique_ptr<CHIPExecItem> LaunchExecItem_;
+
+  /// Argument spill buffer ring. Created on the first launch needing it.
+  std::shared_ptr<CHIPArgSpillPool> ArgSpillPool_;
+
+  /// An operation deferred to the device's submission worker. Kernel
+  /// launches are held inline with their arguments captured to ArgValues.
+  /// The ring slots are reused, so once the buffers of a slot have grown,
+  /// deferring a launch does not allocate.
+  struct CHIPSubmission {
+    /// Operations other than kernel launches.
+    std::function<void()> Op;
+    CHIPKernel *Kernel = nullptr;
+    dim3 NumBlocks;
+    dim3 DimBlocks;
+    size_t SharedMemBytes = 0;
+    std::vector<char> ArgValues;
+    std::vector<void *> Args;
+  };
+  /// Operations deferred to the device's submission worker. Created on the
+  /// first deferred operation.
+  std::unique_ptr<CHIPSPSCRing<CHIPSubmission, 1024>> Submissions_;
+  CHIPSubmissionWorker *SubmissionWorker_ = nullptr;
+  /// Serializes the producers of Submissions_.
+  std::mutex SubmitMtx_;
+  std::atomic<size_t> NumSubmissionsPushed_{0};
+  std::atomic<size_t> NumSubmissionsDone_{0};
+  /// Notified when NumSubmissionsDone_ advances.
+  std::mutex SubmissionsDoneMtx_;
+  std::condition_variable SubmissionsDoneCV_;
+  /// The first error a deferred operation failed with. Reported by the next
+  /// API call which waits for the submissions.
+  std::mutex SubmissionErrorMtx_;
+  std::unique_ptr<CHIPError> SubmissionError_;
+
+  /**
+   * @brief Get the ring slot to fill for the next deferred operation, or
+   * null if the operation can't be deferred. The slot is published by
+   * commitSubmission() while Lock, which locks SubmitMtx_, is held.
+   */
+  CHIPSubmission *beginSubmission(std::unique_lock<std::mutex> &Lock);
+  void commitSubmission();
+  /// Store the error of a failed deferred operation unless one is stored.
+  void storeSubmissionError(const CHIPError &Err);
+  /// Throw and clear the error stored by a failed deferred operation.
+  void throwSubmissionError();
+  /// Throw if the block dimensions exceed the limits of the device.
+  void checkBlockDim(dim3 BlockDim);
+
   enum class MANAGED_MEM_STATE { PRE_KERNEL, POST_KERNEL };
 
   CHIPEvent *RegisteredVarCopy(CHIPExecItem *ExecItem,
@@ -2023,6 +2734,10 @@ public:
   // I want others to be able to lock this queue?
   std::mutex QueueMtx;
 
+  /// Serializes kernel launches on this queue. Guards the queue's kernel
+  /// handles (see CHIPKernel) and LaunchExecItem_.
+  std::mutex LaunchMtx;
+
   virtual CHIPEvent *getLastEvent() = 0;
 
   /**
@@ -2047,19 +2762,52 @@ public:
   virtual ~CHIPQueue();
 
   CHIPQueueFlags getQueueFlags() { return QueueFlags_; }
-  virtual void updateLastEvent(CHIPEvent *NewEvent) {
+
+  uint64_t getUid() const { return Uid_; }
+  size_t getSubmitEpoch() const { return SubmitEpoch_; }
+
+  /**
+   * @brief Return true if the queue has already waited on the given
+   * submission epoch of 'Other'. The caller must hold CHIPDevice::DeviceMtx.
+   */
+  bool hasSyncedWithNoLock(const CHIPQueue &Other, size_t Epoch) const {
+    auto Found = SyncedEpochs_.find(Other.getUid());
+    return Found != SyncedEpochs_.end() && Found->second == Epoch;
+  }
+  /// Record that the queue has waited on the given epoch of 'Other'. The
+  /// caller must hold CHIPDevice::DeviceMtx.
+  void recordSyncNoLock(const CHIPQueue &Other, size_t Epoch) {
+    SyncedEpochs_[Other.getUid()] = Epoch;
+  }
+  /// Drop the record of 'Other'. The caller must hold CHIPDevice::DeviceMtx.
+  void forgetSyncNoLock(const CHIPQueue &Other) {
+    SyncedEpochs_.erase(Other.getUid());
+  }
+  /**
+   * @brief Set the last event of the queue.
+   *
+   * @param NewSubmission false if the event does not stand for new work
+   * other queues may need to synchronize with, such as the barriers of
+   * CHIPContext::syncQueues().
+   */
+  virtual void updateLastEvent(CHIPEvent *NewEvent,
+                               bool NewSubmission = true) {
     LOCK(LastEventMtx); // CHIPQueue::LastEvent_
     logDebug("Setting LastEvent for {} {} -> {}", (void *)this,
              (void *)LastEvent_, (void *)NewEvent);
     if (NewEvent == LastEvent_)
       return;
 
+    if (NewEvent && NewSubmission)
+      SubmitEpoch_++;
+
     if (LastEvent_ != nullptr) {
       LastEvent_->decreaseRefCount("updateLastEvent - old event");
     }
 
     if (NewEvent != nullptr) {
       NewEvent->increaseRefCount("updateLastEvent - new event");
+      NewEvent->setTimelinePoint(Timeline_, Timeline_->submit());
     }
     LastEvent_ = NewEvent;
   }
@@ -2086,6 +2834,12 @@ public:
                                       size_t Size) = 0;
   void memCopyAsync(void *Dst, const void *Src, size_t Size);
 
+  /**
+   * @brief Fetch the module's abort flag at DevFlag to the host after the
+   * work submitted so far. See CHIPDevice::watchAbortFetch().
+   */
+  void fetchAbortFlag(CHIPModule *Module, const void *DevFlag);
+
   /**
    * @brief Blocking memset
    *
@@ -2135,6 +2889,40 @@ public:
                               const void *Src, size_t SPitch, size_t SSPitch,
                               size_t Width, size_t Height, size_t Depth);
 
+  /**
+   * @brief Defer an operation to the device's submission worker, if enabled.
+   *
+   * The operation must not refer to caller owned memory which may change
+   * after the call returns. Returns false if the caller must execute the
+   * operation itself.
+   */
+  bool submitAsync(std::function<void()> &&Op);
+
+  /**
+   * @brief Wait until the worker has executed the operations deferred to
+   * it so far. Rethrows the error of a failed operation.
+   *
+   * Every operation on the queue that is not deferred must call this first.
+   */
+  void waitForSubmissions();
+
+  /**
+   * @brief Execute the deferred operations. Called by the submission worker.
+   *
+   * @return true if any operation was executed.
+   */
+  bool processSubmissions();
+
+  /// Wait for the deferred operations and detach the queue from the
+  /// submission worker. Called before the queue is destroyed.
+  void detachSubmissionWorker();
+
+  /// Return true if deferred operations have not been executed yet.
+  bool hasPendingSubmissions() const;
+
+  /// Return true if operations on the queue may be deferred.
+  bool canSubmitAsync() const;
+
   /**
    * @brief Submit a CHIPExecItem to this queue for execution. CHIPExecItem
    * needs to be complete - contain the kernel and arguments
@@ -2144,6 +2932,18 @@ public:
    */
   virtual CHIPEvent *launchImpl(CHIPExecItem *ExecItem) = 0;
   virtual void launch(CHIPExecItem *ExecItem);
+  /// Same as launch() but the caller must hold LaunchMtx.
+  void launchNoLock(CHIPExecItem *ExecItem);
+
+  /**
+   * @brief Reserve 'SpillBuf' for the next launch of 'Kernel' on the queue.
+   * The space is taken from the queue's ring of 'MemType' memory if it has
+   * room. launchNoLock() hands it back with the launch's event.
+   *
+   * The caller must hold LaunchMtx.
+   */
+  void reserveArgSpillBuffer(CHIPArgSpillBuffer &SpillBuf,
+                             const CHIPKernel &Kernel, hipMemoryType MemType);
 
   /**
    * @brief Get the Device obj
@@ -2158,23 +2958,58 @@ public:
    */
 
   virtual void finish() = 0;
+
+  /**
+   * @brief Output the device printf buffers of the completed commands, if
+   * the backend defers it to a queue synchronization. Does not wait.
+   */
+  virtual void drainPrintfBuffers() {}
+
+  /**
+   * @brief Submit the commands the backend has deferred on this queue, if
+   * any. Does not wait for them to complete.
+   */
+  virtual void flush() {}
+
+  /**
+   * @brief Submit the pending commands and return the last event of the
+   * queue with a reference taken, or null if the queue is idle. The caller
+   * drops the reference with decreaseRefCount().
+   */
+  CHIPEvent *acquireLastEvent() {
+    waitForSubmissions();
+    flush();
+    LOCK(LastEventMtx); // CHIPQueue::LastEvent_
+    if (LastEvent_)
+      LastEvent_->increaseRefCount("acquireLastEvent");
+    return LastEvent_;
+  }
+
+  CHIPQueueTimeline *getTimeline() const { return Timeline_; }
+
   /**
    * @brief Check if the queue is still actively executing
    *
+   * Idle queues are recognized from the timeline without locking or calling
+   * the driver. Otherwise the last event is queried, which also advances
+   * the timeline. So polling a busy queue takes LastEventMtx and calls the
+   * driver each time: the timeline alone can't tell a busy queue from one
+   * whose completion nobody has observed yet.
+   *
    * @return true
    * @return false
    */
-
   bool query() {
-    if (!LastEvent_)
+    if (!hasPendingSubmissions() && Timeline_->isIdle())
       return true;
 
-    if (LastEvent_->updateFinishStatus(false))
-      // LastEvent_->decreaseRefCount("query(): event became ready");
-      if (LastEvent_->isFinished())
-        return true;
-
-    return false;
+    CHIPEvent *Last = acquireLastEvent();
+    if (!Last)
+      return true;
+    Last->updateFinishStatus(false);
+    bool Done = Last->isFinished();
+    Last->decreaseRefCount("query");
+    return Done;
   };
 
   /**
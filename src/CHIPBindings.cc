@@ -182,10 +182,6 @@ hipError_t hipMemPoolDestroy(hipMemPool_t mem_pool) {
   UNIMPLEMENTED(hipErrorNotSupported);
 }
 
-hipError_t hipLaunchHostFunc(hipStream_t stream, hipHostFn_t fn,
-                             void *userData) {
-  UNIMPLEMENTED(hipErrorNotSupported);
-}
 hipError_t hipStreamIsCapturing(hipStream_t stream,
                                 hipStreamCaptureStatus *pCaptureStatus) {
   UNIMPLEMENTED(hipErrorNotSupported);
@@ -226,8 +222,31 @@ hipError_t hipGraphReleaseUserObject(hipGraph_t graph, hipUserObject_t object,
 
 hipError_t hipInit(unsigned int flags) { return hipSuccess; };
 
+// Reports an ignored device side abort() call and resets the module's abort
+// flag so we let there be more aborts.
+static void ignoreAbort(CHIPQueue &Q, CHIPModule &M) {
+  CHIPDeviceVar *Var = M.getGlobalVar("__chipspv_abort_called");
+  int32_t AbortFlag = 0;
+  hipError_t Err = Q.memCopy(Var->getDevAddr(), &AbortFlag, sizeof(int32_t));
+  if (Err != hipSuccess)
+    CHIPERR_LOG_AND_THROW("Unexpected mem copy failure.", hipErrorTbd);
+
+  printf("[ABORT IGNORED]\n");
+}
+
+// Checks the abort flags fetched by the synchronized work. Aborts, unless
+// CHIP_HOST_IGNORES_DEVICE_ABORT is set, are normally handled as soon as
+// the fetches complete, so this catches the ones not noticed yet.
+static void checkAbortRequests(CHIPDevice &Dev) {
+  Dev.checkAbortFetches();
+  for (CHIPModule *M : Dev.takeAbortedModules())
+    ignoreAbort(*Dev.getDefaultQueue(), *M);
+}
+
 // Handles device side abort() call by checking the abort flag global
-// variable used for signaling the request.
+// variable used for signaling the request. The flag is fetched to the host
+// after the launch without blocking it and checked when the fetch
+// completes.
 static void handleAbortRequest(CHIPQueue &Q, CHIPModule &M) {
   logTrace("handleAbortRequest()");
   CHIPDeviceVar *Var = M.getGlobalVar("__chipspv_abort_called");
@@ -239,29 +258,7 @@ static void handleAbortRequest(CHIPQueue &Q, CHIPModule &M) {
     // minimize overheads when abort is not used.
     return;
 
-  int32_t AbortFlag = 0;
-  hipError_t Err = Q.memCopy(&AbortFlag, Var->getDevAddr(), sizeof(int32_t));
-  if (Err != hipSuccess)
-    // We know the abort flag exist so what went wrong on the copy?
-    CHIPERR_LOG_AND_THROW("Unexpected mem copy failure.", hipErrorTbd);
-
-  if (!AbortFlag)
-    return; // Abort was not called.
-
-  // Disable host-side abort behavior for making the unit testing of abort
-  // cases easier.
-  if (!getenv("CHIP_HOST_IGNORES_DEVICE_ABORT"))
-    abort();
-
-  // Just act like nothing happened. Reset the flag so we let there be more
-  // aborts.
-  AbortFlag = 0;
-  Err = Q.memCopy(Var->getDevAddr(), &AbortFlag, sizeof(int32_t));
-  if (Err != hipSuccess)
-    // Device->host copy succeeded. What went wrong with host->device copy?
-    CHIPERR_LOG_AND_THROW("Unexpected mem copy failure.", hipErrorTbd);
-
-  printf("[ABORT IGNORED]\n");
+  Q.fetchAbortFlag(&M, Var->getDevAddr());
 }
 
 hipError_t hipGraphCreate(hipGraph_t *pGraph, unsigned int flags) {
@@ -1424,17 +1421,8 @@ hipError_t hipDeviceSynchronize(void) {
   CHIPInitialize();
 
   auto Dev = Backend->getActiveDevice();
-  {
-    LOCK(Dev->DeviceMtx); // prevents queues from being destryed while iterating
-    for (auto Q : Dev->getQueuesNoLock()) {
-      Q->finish();
-    }
-  }
-
-  Backend->getActiveDevice()->getLegacyDefaultQueue()->finish();
-  if (Backend->getActiveDevice()->isPerThreadStreamUsed()) {
-    Backend->getActiveDevice()->getPerThreadDefaultQueue()->finish();
-  }
+  Dev->waitForQueues();
+  checkAbortRequests(*Dev);
 
   RETURN(hipSuccess);
   CHIP_CATCH
@@ -1662,7 +1650,21 @@ hipError_t hipDeviceGetByPCIBusId(int *DeviceId, const char *PciBusId) {
 hipError_t hipSetDeviceFlags(unsigned Flags) {
   CHIP_TRY
   CHIPInitialize();
-  UNIMPLEMENTED(hipErrorNotSupported);
+  if (Flags & ~(hipDeviceScheduleMask | hipDeviceMapHost |
+                hipDeviceLmemResizeToMax))
+    RETURN(hipErrorInvalidValue);
+
+  switch (Flags & hipDeviceScheduleMask) {
+  case hipDeviceScheduleAuto:
+  case hipDeviceScheduleSpin:
+  case hipDeviceScheduleYield:
+  case hipDeviceScheduleBlockingSync:
+    break;
+  default: // More than one scheduling flag
+    RETURN(hipErrorInvalidValue);
+  }
+
+  Backend->getActiveDevice()->setFlags(Flags);
   RETURN(hipSuccess);
   CHIP_CATCH
 }
@@ -2003,6 +2005,7 @@ hipError_t hipStreamSynchronize(hipStream_t Stream) {
 
   Backend->getActiveDevice()->getContext()->syncQueues(ChipQueue);
   ChipQueue->finish();
+  checkAbortRequests(*ChipQueue->getDevice());
   RETURN(hipSuccess);
 
   CHIP_CATCH
@@ -2106,6 +2109,34 @@ hipError_t hipStreamAddCallback(hipStream_t Stream,
   CHIP_CATCH
 }
 
+/// Stream callback which runs a host function given to hipLaunchHostFunc().
+static void runHostFunc(hipStream_t Stream, hipError_t Status, void *Data) {
+  auto *HostFunc = static_cast<std::pair<hipHostFn_t, void *> *>(Data);
+  HostFunc->first(HostFunc->second);
+  delete HostFunc;
+}
+
+hipError_t hipLaunchHostFunc(hipStream_t Stream, hipHostFn_t Fn,
+                             void *UserData) {
+  CHIP_TRY
+  CHIPInitialize();
+  if (Fn == nullptr)
+    CHIPERR_LOG_AND_THROW("passed in nullptr", hipErrorInvalidValue);
+  auto ChipQueue = static_cast<CHIPQueue *>(Stream);
+  ChipQueue = Backend->findQueue(ChipQueue);
+  if (ChipQueue->getCaptureStatus() != hipStreamCaptureStatusNone) {
+    ChipQueue->setCaptureStatus(hipStreamCaptureStatusInvalidated);
+    RETURN(hipErrorStreamCaptureInvalidated);
+  }
+
+  // Owned by runHostFunc() once the callback has been added.
+  auto HostFn = std::make_unique<std::pair<hipHostFn_t, void *>>(Fn, UserData);
+  ChipQueue->addCallback(runHostFunc, HostFn.get());
+  HostFn.release();
+  RETURN(hipSuccess);
+  CHIP_CATCH
+}
+
 hipError_t hipMemGetAddressRange(hipDeviceptr_t *Base, size_t *Size,
                                  hipDeviceptr_t Ptr) {
   CHIP_TRY
@@ -2157,7 +2188,14 @@ hipError_t hipEventRecord(hipEvent_t Event, hipStream_t Stream) {
     RETURN(hipSuccess);
   }
 
+  // The point is taken before recording so it precedes the commands the
+  // recording itself may submit, but after the deferred operations so it
+  // covers them.
+  ChipQueue->waitForSubmissions();
+  size_t Seq = ChipQueue->getTimeline()->getSubmitted();
+  ChipEvent->clearTimelinePoint();
   ChipEvent->recordStream(ChipQueue);
+  ChipEvent->setTimelinePoint(ChipQueue->getTimeline(), Seq);
   RETURN(hipSuccess);
 
   CHIP_CATCH
@@ -2185,6 +2223,7 @@ hipError_t hipEventSynchronize(hipEvent_t Event) {
   CHIPEvent *ChipEvent = static_cast<CHIPEvent *>(Event);
 
   ChipEvent->wait();
+  checkAbortRequests(*Backend->getActiveDevice());
   RETURN(hipSuccess);
 
   CHIP_CATCH
@@ -2209,6 +2248,12 @@ hipError_t hipEventElapsedTime(float *Ms, hipEvent_t Start, hipEvent_t Stop) {
                           "Unable to return elasped time",
                           hipErrorInvalidResourceHandle);
 
+  // hipEventQuery() may have reported the events done from the progress of
+  // their queues before their timestamps were written.
+  for (CHIPEvent *Event : {ChipEventStart, ChipEventStop})
+    if (Event->isDone() && !Event->isFinished())
+      Event->wait();
+
   *Ms = ChipEventStart->getElapsedTime(ChipEventStop);
   RETURN(hipSuccess);
 
@@ -2221,6 +2266,9 @@ hipError_t hipEventQuery(hipEvent_t Event) {
   NULLCHECK(Event);
   CHIPEvent *ChipEvent = static_cast<CHIPEvent *>(Event);
 
+  if (ChipEvent->isDone())
+    RETURN(hipSuccess);
+
   ChipEvent->updateFinishStatus();
   if (ChipEvent->isFinished())
     RETURN(hipSuccess);
@@ -2777,8 +2825,10 @@ hipError_t hipMemcpy(void *Dst, const void *Src, size_t SizeBytes,
     RETURN(hipSuccess);
   }
 
-  RETURN(Backend->getActiveDevice()->getDefaultQueue()->memCopy(Dst, Src,
-                                                                SizeBytes));
+  auto *ChipQueue = Backend->getActiveDevice()->getDefaultQueue();
+  hipError_t Err = ChipQueue->memCopy(Dst, Src, SizeBytes);
+  checkAbortRequests(*ChipQueue->getDevice());
+  RETURN(Err);
 
   CHIP_CATCH
 }
@@ -4260,7 +4310,9 @@ hipError_t hipOccupancyMaxPotentialBlockSize(int *GridSize, int *BlockSize,
 hipError_t hipGetDeviceFlags(unsigned int *Flags) {
   CHIP_TRY
   CHIPInitialize();
-  UNIMPLEMENTED(hipErrorNotSupported);
+  NULLCHECK(Flags);
+  *Flags = Backend->getActiveDevice()->getFlags();
+  RETURN(hipSuccess);
   CHIP_CATCH
 }
 
@@ -44,6 +44,9 @@ std::once_flag EnvInitialized;
 std::once_flag Uninitialized;
 bool UsingDefaultBackend;
 CHIPBackend *Backend = nullptr;
+bool CHIPAsyncSubmit = false;
+unsigned CHIPDefaultScheduleFlag = hipDeviceScheduleAuto;
+bool CHIPCopyQueue = true;
 std::string CHIPPlatformStr, CHIPDeviceTypeStr, CHIPDeviceStr, CHIPBackendType;
 
 // Uninitializes the backend when the application exits.
@@ -92,10 +95,26 @@ void CHIPReadEnvVarsCallOnce() {
     CHIPBackendType = "default";
   }
 
+  CHIPAsyncSubmit = read_env_var("CHIP_ASYNC_SUBMIT") == "1";
+  CHIPCopyQueue = read_env_var("CHIP_COPY_QUEUE") != "0";
+
+  std::string SyncPolicy = read_env_var("CHIP_SYNC_POLICY");
+  if (SyncPolicy == "spin")
+    CHIPDefaultScheduleFlag = hipDeviceScheduleSpin;
+  else if (SyncPolicy == "yield")
+    CHIPDefaultScheduleFlag = hipDeviceScheduleYield;
+  else if (SyncPolicy == "block")
+    CHIPDefaultScheduleFlag = hipDeviceScheduleBlockingSync;
+  else if (SyncPolicy.size() && SyncPolicy != "auto")
+    logWarn("Ignoring unknown CHIP_SYNC_POLICY={}", SyncPolicy);
+
   logDebug("CHIP_PLATFORM={}", CHIPPlatformStr.c_str());
   logDebug("CHIP_DEVICE_TYPE={}", CHIPDeviceTypeStr.c_str());
   logDebug("CHIP_DEVICE={}", CHIPDeviceStr.c_str());
   logDebug("CHIP_BE={}", CHIPBackendType.c_str());
+  logDebug("CHIP_ASYNC_SUBMIT={}", CHIPAsyncSubmit);
+  logDebug("CHIP_SYNC_POLICY={}", SyncPolicy);
+  logDebug("CHIP_COPY_QUEUE={}", CHIPCopyQueue);
 }
 
 void CHIPReadEnvVars() {
@@ -164,6 +183,9 @@ extern void CHIPInitialize() {
 void CHIPUninitializeCallOnce() {
   logDebug("Uninitializing CHIP...");
   if (Backend) {
+    // Device side aborts may not have been noticed yet.
+    for (auto *Dev : Backend->getDevices())
+      Dev->waitForAbortFetches(nullptr);
     Backend->uninitialize();
     delete Backend;
     Backend = nullptr;
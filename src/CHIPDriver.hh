@@ -62,6 +62,27 @@ class CHIPGraphNode;
  */
 extern CHIPBackend *Backend;
 
+/**
+ * @brief
+ * True if API calls may be deferred to a submission worker thread
+ * (CHIP_ASYNC_SUBMIT=1).
+ */
+extern bool CHIPAsyncSubmit;
+
+/**
+ * @brief
+ * The hipDeviceSchedule* flag applied to devices which use
+ * hipDeviceScheduleAuto (CHIP_SYNC_POLICY).
+ */
+extern unsigned CHIPDefaultScheduleFlag;
+
+/**
+ * @brief
+ * True if the copies and fills of a stream go to a companion queue which
+ * may run on a copy engine (CHIP_COPY_QUEUE, default 1).
+ */
+extern bool CHIPCopyQueue;
+
 /**
  * @brief
  * Singleton backend initialization flag
@@ -85,6 +85,7 @@ CHIPGraph::CHIPGraph(const CHIPGraph &OriginalGraph) {
 CHIPGraphNodeKernel::CHIPGraphNodeKernel(const CHIPGraphNodeKernel &Other)
     : CHIPGraphNode(Other) {
   Params_ = Other.Params_;
+  Args_ = Other.Args_;
   ExecItem_ = Other.ExecItem_->clone();
 }
 
@@ -135,8 +136,11 @@ CHIPGraphNodeKernel::CHIPGraphNodeKernel(const hipKernelNodeParams *TheParams)
                                           Params_.sharedMemBytes, nullptr);
   ExecItem_->setKernel(ChipKernel);
 
-  ExecItem_->copyArgs(TheParams->kernelParams);
-  ExecItem_->setupAllArgs();
+  // The caller may reuse the argument storage once the node is created.
+  Args_ = std::make_shared<CHIPCapturedArgs>(*ChipKernel,
+                                             TheParams->kernelParams);
+  Params_.kernelParams = Args_->getArgs();
+  ExecItem_->copyArgs(Args_->getArgs());
 }
 
 CHIPGraphNodeKernel::CHIPGraphNodeKernel(const void *HostFunction, dim3 GridDim,
@@ -160,8 +164,10 @@ CHIPGraphNodeKernel::CHIPGraphNodeKernel(const void *HostFunction, dim3 GridDim,
       Backend->createCHIPExecItem(GridDim, BlockDim, SharedMem, nullptr);
   ExecItem_->setKernel(ChipKernel);
 
-  ExecItem_->copyArgs(Args);
-  ExecItem_->setupAllArgs();
+  // The caller may reuse the argument storage once the node is created.
+  Args_ = std::make_shared<CHIPCapturedArgs>(*ChipKernel, Args);
+  Params_.kernelParams = Args_->getArgs();
+  ExecItem_->copyArgs(Args_->getArgs());
 }
 
 int NodeCounter = 1;
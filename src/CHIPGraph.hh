@@ -255,6 +255,9 @@ class CHIPGraphNodeKernel : public CHIPGraphNode {
 private:
   hipKernelNodeParams Params_;
   CHIPExecItem *ExecItem_;
+  /// Copy of the argument values taken when the node was created. Shared
+  /// with the clones of this node.
+  std::shared_ptr<CHIPCapturedArgs> Args_;
 
 public:
   CHIPGraphNodeKernel(const CHIPGraphNodeKernel &Other);
@@ -61,6 +61,7 @@
 #include "SPIRVFuncInfo.hh"
 
 #include "logging.hh"
+#include "Utils.hh"
 
 #include <cassert>
 
@@ -203,6 +204,43 @@ void SPVFuncInfo::visitKernelArgs(KernelArgVisitor Visitor) const {
   visitKernelArgsImpl(std::vector<void *>(), Visitor);
 }
 
+std::vector<SPVArgPlanEntry>
+SPVFuncInfo::buildArgPlan(size_t SpillAlignment, size_t &SpillSize) const {
+  std::vector<SPVArgPlanEntry> Plan;
+  Plan.reserve(ArgTypeInfo_.size());
+  SpillSize = 0;
+
+  // Mirrors the argument mapping of visitKernelArgsImpl().
+  unsigned ArgListIndex = 0;
+  for (unsigned ArgIndex = 0; ArgIndex < ArgTypeInfo_.size(); ArgIndex++) {
+    const auto &ArgTI = ArgTypeInfo_[ArgIndex];
+    SPVArgPlanEntry Entry;
+    Entry.Kind = ArgTI.Kind;
+    Entry.StorageClass = ArgTI.StorageClass;
+    Entry.Size = ArgTI.Size;
+    Entry.Index = ArgIndex;
+    Entry.SpillOffset = 0;
+
+    if (isSpilledArg(ArgIndex)) {
+      Entry.Kind = SPVTypeKind::PODByRef;
+      Entry.Size = getSpilledArgSize(ArgIndex);
+      SpillSize = roundUp(SpillSize, SpillAlignment);
+      Entry.SpillOffset = SpillSize;
+      SpillSize += Entry.Size;
+    }
+
+    // The sampler shares the client argument of the preceding image.
+    if (Entry.Kind == SPVTypeKind::Sampler)
+      ArgListIndex--;
+
+    Entry.ClientIndex = ArgListIndex;
+    Plan.push_back(Entry);
+    ArgListIndex++;
+  }
+
+  return Plan;
+}
+
 /// Return HIP user visible kernel argument count.
 unsigned SPVFuncInfo::getNumClientArgs() const {
   unsigned Count = getNumKernelArgs();
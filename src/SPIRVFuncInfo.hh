@@ -23,6 +23,7 @@
 #ifndef SRC_SPIRV_FUNCINFO_H
 #define SRC_SPIRV_FUNCINFO_H
 
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <vector>
@@ -69,6 +70,27 @@ struct SPVArgTypeInfo {
   }
 };
 
+/// A flat record describing how a kernel argument is bound at launch
+/// time. Built once per kernel by SPVFuncInfo::buildArgPlan().
+struct SPVArgPlanEntry {
+  SPVTypeKind Kind;
+  SPVStorageClass StorageClass;
+  uint32_t Size;
+  /// Kernel argument index.
+  uint16_t Index;
+  /// Index to the client argument list. Not meaningful for workgroup
+  /// pointers which do not have a client argument.
+  uint16_t ClientIndex;
+  /// Offset of the argument value in the argument spill buffer
+  /// (SPVTypeKind::PODByRef only).
+  uint32_t SpillOffset;
+
+  bool isWorkgroupPtr() const {
+    return Kind == SPVTypeKind::Pointer &&
+           StorageClass == SPVStorageClass::Workgroup;
+  }
+};
+
 class SPVFuncInfo {
   friend class SPIRVmodule;
   friend class SPIRVinst;
@@ -121,6 +143,14 @@ public:
   /// Return true is any argument is passed via intermediate buffer.
   bool hasByRefArgs() const { return SpilledArgs_.size(); }
 
+  /// Build a flat argument binding plan in kernel argument order.
+  ///
+  /// Spilled (PODByRef) argument values are laid out in a spill buffer
+  /// with 'SpillAlignment' alignment. The total size of the spill buffer
+  /// is returned in 'SpillSize'.
+  std::vector<SPVArgPlanEntry> buildArgPlan(size_t SpillAlignment,
+                                            size_t &SpillSize) const;
+
 private:
   void visitClientArgsImpl(const std::vector<void *> &ArgList,
                            ClientArgVisitor Fn) const;
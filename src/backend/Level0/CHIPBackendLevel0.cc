@@ -28,8 +28,9 @@
  * if L0_IMM_QUEUES is used. There is only one such handle for a queue and a
  * queue can be shared between multiple threads thus this lock is necessary.
  *
- * If immediate command lists are not used, getCmdList will create a new
- * handle which is a thread safe operation
+ * If immediate command lists are not used, getCmdList will return the open
+ * command list of the queue, if any, or create a new handle. The open
+ * command list is locked until executeCommandList() has been called.
  */
 #ifdef L0_IMM_QUEUES
 #define GET_COMMAND_LIST(Queue)                                                \
@@ -39,6 +40,7 @@
 #else
 #define GET_COMMAND_LIST(Queue)                                                \
   ze_command_list_handle_t CommandList;                                        \
+  auto BatchLock = Queue->lockBatch(); /* CHIPQueueLevel0::BatchCmdList_ */    \
   CommandList = Queue->getCmdList();
 #endif
 
@@ -223,33 +225,55 @@ createSampler(CHIPDeviceLevel0 *ChipDev, const hipResourceDesc *PResDesc,
 void CHIPEventLevel0::reset() {
   auto Status = zeEventHostReset(get("zeEventHostReset"));
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  clearTimelinePoint();
+  SubmitQueue_ = nullptr;
+  Retired_ = false;
   LOCK(EventMtx); // CHIPEvent::TrackCalled_
   TrackCalled_ = false;
   EventStatus_ = EVENT_STATUS_INIT;
 }
 
+void CHIPEventLevel0::released() {
+  // Until it is retired, the stale event monitor holds a reference.
+  if (!Retired_ || !EventPool)
+    return;
+  // The event may be reused right away.
+  ((CHIPContextLevel0 *)ChipContext_)->returnEventToPool(this);
+}
+
 ze_event_handle_t CHIPEventLevel0::peek() { return Event_; }
 
-ze_event_handle_t CHIPEventLevel0::get(std::string Msg) {
-  if (Msg.size() > 0) {
-    increaseRefCount(Msg);
-  } else {
-    increaseRefCount("get()");
-  }
+ze_event_handle_t CHIPEventLevel0::get(const char *Reason) {
+  increaseRefCount(Reason);
   return Event_;
 }
 
 CHIPEventLevel0::~CHIPEventLevel0() {
   logTrace("chipEventLevel0 DEST {}", (void *)this);
+  // The queue refers to the event until its batch is submitted.
+  if (isBatchPending()) {
+    try {
+      flushBatch();
+    } catch (CHIPError &Err) {
+      logError("Event {}: submitting the batch failed: {}", (void *)this,
+               Err.getMsgStr());
+      if (CHIPQueueLevel0 *Queue = BatchQueue_)
+        Queue->forgetBatchedEvent(this);
+    }
+  }
   if (Event_) {
     auto Status = zeEventDestroy(Event_);
     // '~CHIPEventLevel0' has a non-throwing exception specification
     assert(Status == ZE_RESULT_SUCCESS);
   }
+  if (TimestampEvent_) {
+    zeEventDestroy(TimestampEvent_);
+    zeEventPoolDestroy(TimestampPool_);
+    zeMemFree(((CHIPContextLevel0 *)ChipContext_)->get(), TimestampResult_);
+  }
   Event_ = nullptr;
   EventPoolHandle_ = nullptr;
   EventPool = nullptr;
-  Timestamp_ = 0;
 }
 
 CHIPEventLevel0::CHIPEventLevel0(CHIPContextLevel0 *ChipCtx,
@@ -257,7 +281,7 @@ CHIPEventLevel0::CHIPEventLevel0(CHIPContextLevel0 *ChipCtx,
                                  unsigned int ThePoolIndex,
                                  CHIPEventFlags Flags)
     : CHIPEvent((CHIPContext *)(ChipCtx), Flags), Event_(nullptr),
-      EventPoolHandle_(nullptr), Timestamp_(0) {
+      EventPoolHandle_(nullptr) {
   LOCK(TheEventPool->EventPoolMtx); // CHIPEventPool::EventPool_ via get()
   EventPool = TheEventPool;
   EventPoolIndex = ThePoolIndex;
@@ -283,14 +307,10 @@ CHIPEventLevel0::CHIPEventLevel0(CHIPContextLevel0 *ChipCtx,
 CHIPEventLevel0::CHIPEventLevel0(CHIPContextLevel0 *ChipCtx,
                                  CHIPEventFlags Flags)
     : CHIPEvent((CHIPContext *)(ChipCtx), Flags), Event_(nullptr),
-      EventPoolHandle_(nullptr), Timestamp_(0), EventPoolIndex(0),
-      EventPool(0) {
+      EventPoolHandle_(nullptr), EventPoolIndex(0), EventPool(0) {
   CHIPContextLevel0 *ZeCtx = (CHIPContextLevel0 *)ChipContext_;
 
   unsigned int PoolFlags = ZE_EVENT_POOL_FLAG_HOST_VISIBLE;
-  // if (!flags.isDisableTiming())
-  //   pool_flags = pool_flags | ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP;
-
   ze_event_pool_desc_t EventPoolDesc = {
       ZE_STRUCTURE_TYPE_EVENT_POOL_DESC, // stype
       nullptr,                           // pNext
@@ -318,18 +338,84 @@ CHIPEventLevel0::CHIPEventLevel0(CHIPContextLevel0 *ChipCtx,
   Status = zeEventCreate(EventPoolHandle_, &EventDesc, &Event_);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd,
                               "Level Zero Event_ creation fail! ");
+
+  // Only the events which may be timed pay for kernel timestamps.
+  if (!Flags.isDisableTiming())
+    createTimestampEvent();
+}
+
+void CHIPEventLevel0::createTimestampEvent() {
+  CHIPContextLevel0 *ZeCtx = (CHIPContextLevel0 *)ChipContext_;
+
+  // Level Zero has been seen to hang when events are host visible and
+  // kernel timings are enabled, so the timestamp event is device only.
+  ze_event_pool_desc_t EventPoolDesc = {
+      ZE_STRUCTURE_TYPE_EVENT_POOL_DESC,   // stype
+      nullptr,                             // pNext
+      ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP, // Flags
+      1                                    // count
+  };
+  ze_result_t Status = zeEventPoolCreate(ZeCtx->get(), &EventPoolDesc, 0,
+                                         nullptr, &TimestampPool_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd,
+                              "Level Zero timestamp event pool creation fail!");
+
+  ze_event_desc_t EventDesc = {
+      ZE_STRUCTURE_TYPE_EVENT_DESC, // stype
+      nullptr,                      // pNext
+      0,                            // index
+      ZE_EVENT_SCOPE_FLAG_DEVICE,   // signal
+      ZE_EVENT_SCOPE_FLAG_DEVICE    // wait
+  };
+  Status = zeEventCreate(TimestampPool_, &EventDesc, &TimestampEvent_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd,
+                              "Level Zero timestamp event creation fail!");
+
+  ze_host_mem_alloc_desc_t HmaDesc = {ZE_STRUCTURE_TYPE_HOST_MEM_ALLOC_DESC,
+                                      nullptr, 0};
+  void *Ptr = nullptr;
+  Status = zeMemAllocHost(ZeCtx->get(), &HmaDesc,
+                          sizeof(ze_kernel_timestamp_result_t),
+                          sizeof(ze_kernel_timestamp_result_t), &Ptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS,
+                              hipErrorMemoryAllocation);
+  TimestampResult_ = (ze_kernel_timestamp_result_t *)Ptr;
+}
+
+bool CHIPEventLevel0::appendSignal(ze_command_list_handle_t CommandList) {
+  ze_result_t Status;
+  if (!TimestampEvent_) {
+    Status = zeCommandListAppendBarrier(CommandList, Event_, 0, nullptr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    return true;
+  }
+
+  // The kernel timestamp of the barrier is the time the stream reached it.
+  // It is copied to host memory before the host visible event is signaled.
+  Status = zeCommandListAppendEventReset(CommandList, TimestampEvent_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status =
+      zeCommandListAppendBarrier(CommandList, TimestampEvent_, 0, nullptr);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Status = zeCommandListAppendQueryKernelTimestamps(
+      CommandList, 1, &TimestampEvent_, TimestampResult_, nullptr, Event_, 1,
+      &TimestampEvent_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  return false;
 }
 
 CHIPEventLevel0::CHIPEventLevel0(CHIPContextLevel0 *ChipCtx,
                                  ze_event_handle_t NativeEvent)
     : CHIPEvent((CHIPContext *)(ChipCtx)), Event_(NativeEvent),
-      EventPoolHandle_(nullptr), Timestamp_(0), EventPoolIndex(0),
-      EventPool(nullptr) {}
+      EventPoolHandle_(nullptr), EventPoolIndex(0), EventPool(nullptr) {}
 
-// Must use this for now - Level Zero hangs when events are host visible +
-// kernel timings are enabled
 void CHIPEventLevel0::recordStream(CHIPQueue *ChipQueue) {
-  ze_result_t Status;
+  if (ChipQueue == nullptr)
+    CHIPERR_LOG_AND_THROW("Queue passed in is null", hipErrorTbd);
+  // A previous recording of this event may still be deferred.
+  ChipQueue->waitForSubmissions();
+  // Submit a previous recording of this event which may still be batched.
+  flushBatch();
 
   {
     LOCK(EventMtx); // CHIPEvent::EventStatus_
@@ -339,53 +425,19 @@ void CHIPEventLevel0::recordStream(CHIPQueue *ChipQueue) {
       ze_result_t Status = zeEventHostReset(Event_);
       EventStatus_ = EVENT_STATUS_INIT;
       HostTimestamp_ = 0;
-      DeviceTimestamp_ = 0;
       CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
     }
   }
 
-  auto Dev = (CHIPDeviceLevel0 *)ChipQueue->getDevice();
-  Status = zeDeviceGetGlobalTimestamps(Dev->get(), &HostTimestamp_,
-                                       &DeviceTimestamp_);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-
-  if (ChipQueue == nullptr)
-    CHIPERR_LOG_AND_THROW("Queue passed in is null", hipErrorTbd);
-
-  CHIPQueueLevel0 *Q = (CHIPQueueLevel0 *)ChipQueue;
-  GET_COMMAND_LIST(Q)
-  // The application must not call this function from
-  // simultaneous threads with the same command list handle.
-  Status = zeCommandListAppendBarrier(CommandList, nullptr, 0, nullptr);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  // The application must not call this function from
-  // simultaneous threads with the same command list handle.
-  Status = zeCommandListAppendWriteGlobalTimestamp(
-      CommandList, (uint64_t *)(Q->getSharedBufffer()), nullptr, 0, nullptr);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  // The application must not call this function from
-  // simultaneous threads with the same command list handle.
-  Status = zeCommandListAppendBarrier(CommandList, nullptr, 0, nullptr);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  // The application must not call this function from
-  // simultaneous threads with the same command list handle.
-  Status = zeCommandListAppendMemoryCopy(CommandList, &Timestamp_,
-                                         Q->getSharedBufffer(),
-                                         sizeof(uint64_t), Event_, 0, nullptr);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-
-  auto DestoyCommandListEvent =
-      ((CHIPBackendLevel0 *)Backend)->createCHIPEvent(this->ChipContext_);
-  DestoyCommandListEvent->Msg = "recordStreamComplete";
-  // The application must not call this function from
-  // simultaneous threads with the same command list handle.
-  // Done via GET_COMMAND_LIST
-  Status = zeCommandListAppendBarrier(
-      CommandList, DestoyCommandListEvent->peek(), 0, nullptr);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  // The host time only serves to order the events in getElapsedTime().
+  if (!Flags_.isDisableTiming())
+    HostTimestamp_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
 
-  Q->executeCommandList(CommandList);
-  DestoyCommandListEvent->track();
+  // The status and, for timing events, the kernel timestamp of the event
+  // come from the barrier appended by appendSignal().
+  ((CHIPQueueLevel0 *)ChipQueue)->appendEventRecord(this);
 
   LOCK(EventMtx); // CHIPEvent::EventStatus_
   EventStatus_ = EVENT_STATUS_RECORDING;
@@ -394,16 +446,43 @@ void CHIPEventLevel0::recordStream(CHIPQueue *ChipQueue) {
 
 bool CHIPEventLevel0::wait() {
   logTrace("CHIPEventLevel0::wait() {} msg={}", (void *)this, Msg);
+  flushBatch();
+
+  ChipContext_->getDevice()->synchronize(
+      [&]() { return zeEventQueryStatus(Event_) == ZE_RESULT_SUCCESS; },
+      [&]() {
+        ze_result_t Status = zeEventHostSynchronize(Event_, UINT64_MAX);
+        CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+      });
 
-  ze_result_t Status = zeEventHostSynchronize(Event_, UINT64_MAX);
+  LOCK(EventMtx); // CHIPEvent::EventStatus_
+  setRecorded();
+  return true;
+}
+
+bool CHIPEventLevel0::waitFor(uint64_t TimeoutNs) {
+  if (isBatchPending())
+    return false;
+
+  ze_result_t Status = zeEventHostSynchronize(Event_, TimeoutNs);
+  if (Status == ZE_RESULT_NOT_READY)
+    return false;
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
 
   LOCK(EventMtx); // CHIPEvent::EventStatus_
-  EventStatus_ = EVENT_STATUS_RECORDED;
+  setRecorded();
   return true;
 }
 
 bool CHIPEventLevel0::updateFinishStatus(bool ThrowErrorIfNotReady) {
+  if (isBatchPending()) {
+    // The event monitors poll with ThrowErrorIfNotReady=false while holding
+    // locks the batch submission needs, so only user queries submit.
+    if (!ThrowErrorIfNotReady)
+      return false;
+    flushBatch();
+  }
+
   std::string EventStatusOld, EventStatusNew;
   {
     LOCK(EventMtx); // CHIPEvent::EventStatus_
@@ -415,7 +494,7 @@ bool CHIPEventLevel0::updateFinishStatus(bool ThrowErrorIfNotReady) {
       CHIPERR_LOG_AND_THROW("Event Not Ready", hipErrorNotReady);
     }
     if (Status == ZE_RESULT_SUCCESS)
-      EventStatus_ = EVENT_STATUS_RECORDED;
+      setRecorded();
 
     EventStatusNew = getEventStatusStr();
   }
@@ -428,44 +507,24 @@ bool CHIPEventLevel0::updateFinishStatus(bool ThrowErrorIfNotReady) {
   return false;
 }
 
-/** This Doesn't work right now due to Level Zero Backend hanging?
-  unsinged long CHIPEventLevel0::getFinishTime() {
-
-    ze_kernel_timestamp_result_t res{};
-    auto Status = zeEventQueryKernelTimestamp(Event_, &res);
-    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-
-    CHIPContextLevel0* chip_ctx_lz = (CHIPContextLevel0*)chip_context;
-    CHIPDeviceLevel0* chip_dev_lz =
-        (CHIPDeviceLevel0*)chip_ctx_lz->getDevices()[0];
-
-    auto props = chip_dev_lz->getDeviceProps();
-
-    uint64_t timerResolution = props->timerResolution;
-    uint32_t timestampValidBits = props->timestampValidBits;
-
-    return res.context.kernelEnd * timerResolution;
-  }
-  */
-
 uint32_t CHIPEventLevel0::getValidTimestampBits() {
   CHIPContextLevel0 *ChipCtxLz = (CHIPContextLevel0 *)ChipContext_;
   CHIPDeviceLevel0 *ChipDevLz = (CHIPDeviceLevel0 *)ChipCtxLz->getDevice();
   auto Props = ChipDevLz->getDeviceProps();
-  return Props->timestampValidBits;
+  return Props->kernelTimestampValidBits;
 }
 
-unsigned long CHIPEventLevel0::getFinishTime() {
-  CHIPContextLevel0 *ChipCtxLz = (CHIPContextLevel0 *)ChipContext_;
-  CHIPDeviceLevel0 *ChipDevLz = (CHIPDeviceLevel0 *)ChipCtxLz->getDevice();
-  auto Props = ChipDevLz->getDeviceProps();
-
-  uint64_t TimerResolution = Props->timerResolution;
-  uint32_t TimestampValidBits = Props->timestampValidBits;
-
-  uint32_t T = (Timestamp_ & (((uint64_t)1 << TimestampValidBits) - 1));
-  T = T * TimerResolution;
-
+uint64_t CHIPEventLevel0::getFinishTime() {
+  if (!TimestampResult_)
+    CHIPERR_LOG_AND_THROW("Event was created without timing",
+                          hipErrorInvalidResourceHandle);
+
+  // The global timer is shared by all the engines of the device so the
+  // timestamps of events recorded on different queues are comparable.
+  uint64_t T = TimestampResult_->global.kernelEnd;
+  uint32_t ValidBits = getValidTimestampBits();
+  if (ValidBits < 64)
+    T &= ((uint64_t)1 << ValidBits) - 1;
   return T;
 }
 
@@ -483,8 +542,8 @@ float CHIPEventLevel0::getElapsedTime(CHIPEvent *OtherIn) {
     CHIPERR_LOG_AND_THROW("One of the events for getElapsedTime() was done yet",
                           hipErrorNotReady);
 
-  uint32_t Started = this->getFinishTime();
-  uint32_t Finished = Other->getFinishTime();
+  uint64_t Started = this->getFinishTime();
+  uint64_t Finished = Other->getFinishTime();
   auto StartedCPU = this->getHostTimestamp();
   auto FinishedCPU = Other->getHostTimestamp();
 
@@ -496,44 +555,44 @@ float CHIPEventLevel0::getElapsedTime(CHIPEvent *OtherIn) {
    * values.
    * https://spec.oneapi.io/level-zero/latest/core/PROG.html#kernel-timestamp-events
    */
-  // uint64_t Elapsed = std::fabs(Finished - Started);
-  // Infering temporal order anyways because hipEvent unit tests expects it
-
-  // Resolve overflows
-  // hipEventElapsed(start, stop)
+  // Infering temporal order from the host times of the recordings because
+  // hipEvent unit tests expects it.
   bool ReversedEvents = false;
   if (FinishedCPU < StartedCPU) {
     ReversedEvents = true;
-    auto Temp = Started;
-    Started = Finished;
-    Finished = Temp;
+    std::swap(Started, Finished);
   }
 
-  if (Finished < Started) {
-    const uint64_t maxValue = (1ull << getValidTimestampBits()) - 1;
-    Finished = Finished + (maxValue - Started);
-  }
+  // Resolve an overflow of the device timer.
+  uint32_t ValidBits = getValidTimestampBits();
+  if (Finished < Started && ValidBits < 64)
+    Finished += (uint64_t)1 << ValidBits;
 
-  int64_t Elapsed = (Finished - Started);
+  CHIPContextLevel0 *ChipCtxLz = (CHIPContextLevel0 *)ChipContext_;
+  CHIPDeviceLevel0 *ChipDevLz = (CHIPDeviceLevel0 *)ChipCtxLz->getDevice();
+  // Nanoseconds per timer tick.
+  uint64_t TimerResolution = ChipDevLz->getDeviceProps()->timerResolution;
 
-#define NANOSECS 1000000000
-  int64_t MS = (Elapsed / NANOSECS) * 1000;
-  int64_t NS = Elapsed % NANOSECS;
-  float FractInMS = ((float)NS) / 1000000.0f;
-  auto Ms = (float)MS + FractInMS;
+  double ElapsedNs = (double)(Finished - Started) * TimerResolution;
+  float Ms = (float)(ElapsedNs / 1000000.0);
 
   if (ReversedEvents)
     Ms = Ms * -1;
   return Ms;
 }
 
+void CHIPEventLevel0::flushBatch() {
+  if (CHIPQueueLevel0 *Queue = BatchQueue_)
+    Queue->flush();
+}
+
 void CHIPEventLevel0::hostSignal() {
   logTrace("CHIPEventLevel0::hostSignal()");
   auto Status = zeEventHostSignal(Event_);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
 
   LOCK(EventMtx); // CHIPEvent::EventStatus_
-  EventStatus_ = EVENT_STATUS_RECORDED;
+  setRecorded();
 }
 
 // End CHIPEventLevel0
@@ -568,45 +627,69 @@ CHIPCallbackDataLevel0::CHIPCallbackDataLevel0(hipStreamCallback_t CallbackF,
 // CHIPEventMonitorLevel0
 // ***********************************************************************
 
-void CHIPCallbackEventMonitorLevel0::monitor() {
-  CHIPCallbackDataLevel0 *CallbackData;
-  while (true) {
-    usleep(20000);
-    LOCK(EventMonitorMtx); // CHIPEventMonitor::Stop
-    {
+/// How long a callback waiter blocks on the event gating its oldest
+/// callback before it checks whether it has been closed.
+static constexpr uint64_t CallbackTimeoutNs = 20000000;
 
-      if (Stop) {
-        logTrace(
-            "CHIPCallbackEventMonitorLevel0 out of callbacks. Exiting thread");
-        if (Backend->CallbackQueue.size())
-          logError("Callback thread exiting while there are still active "
-                   "callbacks in the queue");
-        pthread_exit(0);
-      }
-
-      LOCK(Backend->CallbackQueueMtx); // CHIPBackend::CallbackQueue
-
-      if ((Backend->CallbackQueue.size() == 0))
-        continue;
+void CHIPCallbackEventMonitorLevel0::wakeUp() {
+  // Taking the mutex orders the wake-up after a concurrent predicate check.
+  { LOCK(Backend->CallbackQueueMtx); } // CHIPBackend::CallbackQueueCond
+  Backend->CallbackQueueCond.notify_all();
+}
 
-      // get the callback item
-      CallbackData = (CHIPCallbackDataLevel0 *)Backend->CallbackQueue.front();
+void CHIPCallbackEventMonitorLevel0::dispatchCallbacks() {
+  // No waiters are started once the monitor stops.
+  if (Backend->CallbackQueue.empty() || Stop)
+    return;
 
-      // Lock the item and members
-      assert(CallbackData);
-      LOCK( // CHIPBackend::CallbackQueue
-          CallbackData->CallbackDataMtx);
+  std::vector<StreamWaiter *> Notify;
+  {
+    LOCK(WaitersMtx_); // CHIPCallbackEventMonitorLevel0::Waiters_
+    while (!Backend->CallbackQueue.empty()) {
+      auto *CallbackData =
+          (CHIPCallbackDataLevel0 *)Backend->CallbackQueue.front();
       Backend->CallbackQueue.pop();
+      auto &Waiter = Waiters_[CallbackData->ChipQueue];
+      if (!Waiter) {
+        Waiter = std::make_unique<StreamWaiter>();
+        StreamWaiter *W = Waiter.get();
+        W->Thread = std::thread([this, W]() { runWaiter(*W); });
+      }
+      {
+        LOCK(Waiter->Mtx); // StreamWaiter::Incoming
+        Waiter->Incoming.push_back(CallbackData);
+      }
+      if (std::find(Notify.begin(), Notify.end(), Waiter.get()) ==
+          Notify.end())
+        Notify.push_back(Waiter.get());
+    }
+  }
+  for (auto *Waiter : Notify)
+    Waiter->Cond.notify_one();
+}
 
-      // Update Status
-      logTrace("CHIPCallbackEventMonitorLevel0::monitor() checking event "
-               "status for {}",
-               (void *)CallbackData->GpuReady);
-      CallbackData->GpuReady->updateFinishStatus(false);
-      if (CallbackData->GpuReady->getEventStatus() != EVENT_STATUS_RECORDED) {
-        // if not ready, push to the back
-        Backend->CallbackQueue.push(CallbackData);
-        continue;
+void CHIPCallbackEventMonitorLevel0::runWaiter(StreamWaiter &Waiter) {
+  while (true) {
+    CHIPCallbackDataLevel0 *CallbackData;
+    {
+      std::unique_lock<std::mutex> Lock(Waiter.Mtx); // StreamWaiter::Incoming
+      Waiter.Cond.wait(
+          Lock, [&]() { return !Waiter.Incoming.empty() || Waiter.Closed; });
+      if (Waiter.Incoming.empty())
+        return;
+      CallbackData = Waiter.Incoming.front();
+    }
+
+    // Each callback waits on the device for the previous one of the stream
+    // to complete, so only the oldest one can become ready.
+    auto GpuReady = (CHIPEventLevel0 *)CallbackData->GpuReady;
+    GpuReady->flushBatch();
+    while (!GpuReady->waitFor(CallbackTimeoutNs)) {
+      LOCK(Waiter.Mtx); // StreamWaiter::Closed
+      if (Waiter.Closed) {
+        logError("CHIPCallbackEventMonitorLevel0: {} callbacks were not run",
+                 Waiter.Incoming.size());
+        return;
       }
     }
 
@@ -614,99 +697,310 @@ void CHIPCallbackEventMonitorLevel0::monitor() {
     CallbackData->CpuCallbackComplete->hostSignal();
     CallbackData->GpuAck->wait();
 
+    {
+      LOCK(Waiter.Mtx); // StreamWaiter::Incoming
+      Waiter.Incoming.pop_front();
+    }
     delete CallbackData;
-    pthread_yield();
   }
 }
 
-void CHIPStaleEventMonitorLevel0::monitor() {
-  // Stop is false and I have more events
-  while (true) {
-    usleep(20000);
-    LOCK(EventMonitorMtx); // CHIPEventMonitor::Stop
-    std::vector<CHIPEvent *> EventsToDelete;
-    std::vector<ze_command_list_handle_t> CommandListsToDelete;
+void CHIPCallbackEventMonitorLevel0::closeWaiter(StreamWaiter &Waiter) {
+  {
+    LOCK(Waiter.Mtx); // StreamWaiter::Closed
+    Waiter.Closed = true;
+  }
+  Waiter.Cond.notify_one();
+  Waiter.Thread.join();
+}
 
-    LOCK(Backend->EventsMtx); // CHIPBackend::Events
-    LOCK(                     // CHIPBackendLevel0::EventCommandListMap
-        ((CHIPBackendLevel0 *)Backend)->CommandListsMtx);
-    // auto LzBackend = (CHIPBackendLevel0 *)Backend;
-    // logTrace("CHIPStaleEventMonitorLevel0::monitor() # events {} # queues
-    // {}",
-    //          Backend->Events.size(), LzBackend->EventCommandListMap.size());
+void CHIPCallbackEventMonitorLevel0::forgetQueue(const CHIPQueue *Queue) {
+  std::unique_ptr<StreamWaiter> Waiter;
+  {
+    LOCK(Backend->CallbackQueueMtx); // CHIPBackend::CallbackQueue
+    dispatchCallbacks();
+    LOCK(WaitersMtx_); // CHIPCallbackEventMonitorLevel0::Waiters_
+    auto Found = Waiters_.find(Queue);
+    if (Found == Waiters_.end())
+      return;
+    Waiter = std::move(Found->second);
+    Waiters_.erase(Found);
+  }
+  // The stream has finished, so its callbacks have run.
+  closeWaiter(*Waiter);
+}
 
-    auto EventCommandListMap =
-        &((CHIPBackendLevel0 *)Backend)->EventCommandListMap;
+void CHIPCallbackEventMonitorLevel0::monitor() {
+  {
+    std::unique_lock<std::mutex> Lock( // CHIPBackend::CallbackQueue
+        Backend->CallbackQueueMtx);
+    while (true) {
+      // Sleeps until a callback is added.
+      Backend->CallbackQueueCond.wait(
+          Lock, [&]() { return !Backend->CallbackQueue.empty() || Stop; });
+      if (Stop)
+        break;
+      dispatchCallbacks();
+    }
+  }
 
-    for (size_t i = 0; i < Backend->Events.size(); i++) {
-      CHIPEvent *ChipEvent = Backend->Events[i];
+  std::map<const CHIPQueue *, std::unique_ptr<StreamWaiter>> Waiters;
+  {
+    LOCK(WaitersMtx_); // CHIPCallbackEventMonitorLevel0::Waiters_
+    Waiters.swap(Waiters_);
+  }
+  // The waiters run the callbacks which are ready and report the rest.
+  for (auto &Waiter : Waiters)
+    closeWaiter(*Waiter.second);
+
+  logTrace("CHIPCallbackEventMonitorLevel0 out of callbacks. Exiting thread");
+  if (Backend->CallbackQueue.size())
+    logError("Callback thread exiting while there are still active "
+             "callbacks in the queue");
+  pthread_exit(0);
+}
 
-      assert(ChipEvent);
-      auto E = (CHIPEventLevel0 *)ChipEvent;
+/// How long a waiter of the stale event monitor blocks on an event before
+/// it checks whether it has been closed.
+static constexpr uint64_t StaleEventTimeoutNs = 20000000;
 
-      // do not change refcount for user events
-      if (E->updateFinishStatus(false) && E->EventPool) {
-        E->decreaseRefCount("Event became ready");
-        E->releaseDependencies();
-      }
+void CHIPStaleEventMonitorLevel0::wakeUp() {
+  // Taking the mutex orders the wake-up after a concurrent predicate check.
+  { LOCK(Backend->EventsMtx); } // CHIPBackend::EventsCond
+  Backend->EventsCond.notify_all();
+}
 
-      // delete the event if refcount reached 0
-      if (E->getCHIPRefc() == 0) {
-        auto Found =
-            std::find(Backend->Events.begin(), Backend->Events.end(), E);
-        if (Found == Backend->Events.end())
-          CHIPERR_LOG_AND_THROW("StaleEventMonitor is trying to destroy an "
-                                "event which is already "
-                                "removed from backend event list",
-                                hipErrorTbd);
-        Backend->Events.erase(Found); // TODO fix-251 segfault here
-
-        if (E->EventPool)
-          E->EventPool->returnSlot(E->EventPoolIndex);
-
-        E->doActions();
-
-        // Check if this event is associated with a CommandList
-        bool CommandListFound = EventCommandListMap->count(E);
-        if (CommandListFound) {
-          logTrace("Erase cmdlist assoc w/ event: {}", (void *)E);
-          auto CommandList = (*EventCommandListMap)[E];
-          EventCommandListMap->erase(E);
+void CHIPStaleEventMonitorLevel0::wakeWaiter(const CHIPQueueLevel0 *Queue) {
+  LOCK(WaitersMtx_); // CHIPStaleEventMonitorLevel0::Waiters_
+  auto Found = Waiters_.find(Queue);
+  if (Found == Waiters_.end())
+    return;
+  QueueWaiter &Waiter = *Found->second;
+  { LOCK(Waiter.Mtx); } // QueueWaiter::Cond
+  Waiter.Cond.notify_one();
+}
 
-#ifdef DUBIOUS_LOCKS
-          LOCK(Backend->DubiousLockLevel0)
-#endif
-          // The application must not call this function
-          // from simultaneous threads with the same command list handle.
-          // Done via this is the only thread that calls it
-          auto Status = zeCommandListDestroy(CommandList);
-          CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-        }
-      }
+void CHIPStaleEventMonitorLevel0::dispatchTrackedEvents() {
+  // No waiters are started once the monitor stops.
+  if (Backend->Events.empty() || Stop)
+    return;
 
-    } // done collecting events to delete
-
-    /**
-     * In the case that a user doesn't destroy all the
-     * created streams, we remove the streams and outstanding events in
-     * CHIPBackend::waitForThreadExit() but CHIPBackend has no knowledge of
-     * EventCommandListMap
-     */
-    // TODO libCEED - re-enable this check
-    if (Stop && !EventCommandListMap->size()) {
-      if (Backend->Events.size() > 0) {
-        logError(
-            "CHIPStaleEventMonitorLevel0 stop was called but not all events "
-            "have been cleared");
-      } else {
-        logTrace(
-            "CHIPStaleEventMonitorLevel0 stop was called and all events have "
-            "been cleared");
+  std::vector<QueueWaiter *> Notify;
+  {
+    LOCK(WaitersMtx_); // CHIPStaleEventMonitorLevel0::Waiters_
+    for (auto *E : Backend->Events) {
+      auto *ELz = (CHIPEventLevel0 *)E;
+      const CHIPQueueLevel0 *Queue = ELz->getSubmitQueue();
+      auto &Waiter = Waiters_[Queue];
+      if (!Waiter) {
+        Waiter = std::make_unique<QueueWaiter>();
+        QueueWaiter *W = Waiter.get();
+        // The events of a known queue finish in order.
+        bool InOrder = Queue != nullptr;
+        W->Thread =
+            std::thread([this, W, InOrder]() { runWaiter(*W, InOrder); });
       }
-      pthread_exit(0);
+      {
+        LOCK(Waiter->Mtx); // QueueWaiter::Incoming
+        Waiter->Incoming.push_back(ELz);
+      }
+      if (Notify.empty() || Notify.back() != Waiter.get())
+        Notify.push_back(Waiter.get());
+    }
+  }
+  Backend->Events.clear();
+  for (auto *Waiter : Notify)
+    Waiter->Cond.notify_one();
+}
+
+void CHIPStaleEventMonitorLevel0::runWaiter(QueueWaiter &Waiter,
+                                            bool InOrder) {
+  // Only this thread touches the events once they are handed over.
+  std::deque<CHIPEventLevel0 *> Events;
+  auto CanBlock = [&]() {
+    return !Events.empty() && !Events.front()->isBatchPending();
+  };
+
+  bool Closed = false;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> Lock(Waiter.Mtx); // QueueWaiter::Incoming
+      // Flushing the batch of the oldest event wakes us up only while we
+      // are counted. Counting before the check closes the race with it.
+      bool WaitsForBatch = !Events.empty() && !CanBlock();
+      if (WaitsForBatch)
+        NumWaitingForBatch_++;
+      Waiter.Cond.wait(Lock, [&]() {
+        return CanBlock() || !Waiter.Incoming.empty() || Waiter.Closed;
+      });
+      if (WaitsForBatch)
+        NumWaitingForBatch_--;
+      Events.insert(Events.end(), Waiter.Incoming.begin(),
+                    Waiter.Incoming.end());
+      Waiter.Incoming.clear();
+      Closed = Waiter.Closed;
+    }
+
+    if (!CanBlock()) {
+      if (Closed)
+        break;
+      continue;
+    }
+    // Once the oldest event has finished, a run of events of an in-order
+    // queue can be retired without looking at the rest.
+    bool Finished = Events.front()->waitFor(StaleEventTimeoutNs);
+    retireFinishedEvents(Events, InOrder);
+    if (!Finished && Closed)
+      break;
+  }
+
+  if (Events.size()) {
+    logError("CHIPStaleEventMonitorLevel0: {} events were not retired",
+             Events.size());
+    for (auto *E : Events)
+      logTrace("{} status= {} refc={}", E->Msg, E->getEventStatusStr(),
+               E->getCHIPRefc());
+  }
+}
+
+void CHIPStaleEventMonitorLevel0::retireFinishedEvents(
+    std::deque<CHIPEventLevel0 *> &Events, bool InOrder) {
+  // A finished event is no longer referenced by an unsubmitted batch.
+  auto IsFinished = [](CHIPEventLevel0 *E) {
+    if (E->isBatchPending())
+      return false;
+    E->updateFinishStatus(false);
+    return E->isFinished();
+  };
+
+  std::vector<CHIPEventLevel0 *> Retired;
+  if (InOrder) {
+    // The queues are in-order, so the events of a queue retire in a run
+    // from the oldest one.
+    while (!Events.empty() && IsFinished(Events.front())) {
+      Retired.push_back(Events.front());
+      Events.pop_front();
+    }
+  } else {
+    auto Unfinished = std::stable_partition(
+        Events.begin(), Events.end(),
+        [&](CHIPEventLevel0 *E) { return !IsFinished(E); });
+    Retired.assign(Unfinished, Events.end());
+    Events.erase(Unfinished, Events.end());
+  }
+  if (Retired.empty())
+    return;
+
+  // Before the events may go back to the pool and be reused.
+  recycleCommandLists(Retired);
+
+  for (auto *E : Retired) {
+    E->markRetired();
+    E->doActions();
+    // do not change refcount for user events
+    if (E->EventPool) {
+      E->releaseDependencies();
+      E->decreaseRefCount("Event became ready");
+    }
+  }
+}
+
+void CHIPStaleEventMonitorLevel0::recycleCommandLists(
+    const std::vector<CHIPEventLevel0 *> &Retired) {
+  std::vector<LZSubmittedCommandList> Finished;
+  {
+    LOCK( // CHIPBackendLevel0::EventCommandListMap
+        ((CHIPBackendLevel0 *)Backend)->CommandListsMtx);
+    auto &EventCommandListMap =
+        ((CHIPBackendLevel0 *)Backend)->EventCommandListMap;
+    for (auto *E : Retired) {
+      auto Found = EventCommandListMap.find(E);
+      if (Found == EventCommandListMap.end())
+        continue;
+      logTrace("Erase cmdlist assoc w/ event: {}", (void *)Found->first);
+      Finished.push_back(std::move(Found->second));
+      EventCommandListMap.erase(Found);
     }
+  }
 
-  } // endless loop
+  // The trailing barrier of each list has signaled, so all of its commands
+  // have completed and the list may be reset.
+  for (auto &CommandList : Finished) {
+    CommandList.Placement->completed();
+    CommandList.Pool->release(CommandList.Handle);
+  }
+}
+
+void CHIPStaleEventMonitorLevel0::closeWaiter(QueueWaiter &Waiter) {
+  {
+    LOCK(Waiter.Mtx); // QueueWaiter::Closed
+    Waiter.Closed = true;
+  }
+  Waiter.Cond.notify_one();
+  Waiter.Thread.join();
+}
+
+void CHIPStaleEventMonitorLevel0::forgetQueue(const CHIPQueueLevel0 *Queue) {
+  std::unique_ptr<QueueWaiter> Waiter;
+  {
+    LOCK(Backend->EventsMtx); // CHIPBackend::Events
+    // The waiter gets the events of the queue not handed over yet.
+    dispatchTrackedEvents();
+    LOCK(WaitersMtx_); // CHIPStaleEventMonitorLevel0::Waiters_
+    auto Found = Waiters_.find(Queue);
+    if (Found == Waiters_.end())
+      return;
+    Waiter = std::move(Found->second);
+    Waiters_.erase(Found);
+  }
+  // The queue has finished, so this takes no longer than a retirement.
+  closeWaiter(*Waiter);
+}
+
+void CHIPStaleEventMonitorLevel0::monitor() {
+  {
+    std::unique_lock<std::mutex> Lock( // CHIPBackend::Events
+        Backend->EventsMtx);
+    while (true) {
+      // Sleeps until an event is tracked.
+      Backend->EventsCond.wait(
+          Lock, [&]() { return !Backend->Events.empty() || Stop; });
+      if (Stop)
+        break;
+      dispatchTrackedEvents();
+    }
+  }
+
+  /**
+   * In the case that a user doesn't destroy all the
+   * created streams, we remove the streams and outstanding events in
+   * CHIPBackend::waitForThreadExit() but CHIPBackend has no knowledge of
+   * EventCommandListMap
+   */
+  std::map<const CHIPQueueLevel0 *, std::unique_ptr<QueueWaiter>> Waiters;
+  {
+    LOCK(WaitersMtx_); // CHIPStaleEventMonitorLevel0::Waiters_
+    Waiters.swap(Waiters_);
+  }
+  // The waiters retire what has finished and report the rest.
+  for (auto &Waiter : Waiters)
+    closeWaiter(*Waiter.second);
+
+  size_t NumCommandLists;
+  {
+    LOCK( // CHIPBackendLevel0::EventCommandListMap
+        ((CHIPBackendLevel0 *)Backend)->CommandListsMtx);
+    NumCommandLists =
+        ((CHIPBackendLevel0 *)Backend)->EventCommandListMap.size();
+  }
+  if (NumCommandLists)
+    logError("CHIPStaleEventMonitorLevel0 stop was called but {} command "
+             "lists have not been recycled",
+             NumCommandLists);
+  else
+    logTrace("CHIPStaleEventMonitorLevel0 stop was called and all events "
+             "have been cleared");
+  pthread_exit(0);
 }
 // End CHIPEventMonitorLevel0
 
@@ -715,6 +1009,62 @@ void CHIPStaleEventMonitorLevel0::monitor() {
 
 ze_kernel_handle_t CHIPKernelLevel0::get() { return ZeKernel_; }
 
+CHIPKernelHandleLevel0 &
+CHIPKernelLevel0::getHandle(const CHIPQueue *ChipQueue) {
+  LOCK(QueueHandlesMtx_); // CHIPKernelLevel0::QueueHandles_
+  auto &Handle = QueueHandles_[ChipQueue];
+  if (Handle)
+    return *Handle;
+
+  Handle = std::make_unique<CHIPKernelHandleLevel0>();
+  Handle->ArgShadow = CHIPArgShadow(getArgPlan());
+  if (QueueHandles_.size() == 1) {
+    Handle->ZeKernel = ZeKernel_;
+    return *Handle;
+  }
+
+  ze_kernel_desc_t KernelDesc = {ZE_STRUCTURE_TYPE_KERNEL_DESC, nullptr,
+                                 0, // flags
+                                 HostFName_.c_str()};
+  ze_result_t Status =
+      zeKernelCreate(Module->get(), &KernelDesc, &Handle->ZeKernel);
+  if (Status != ZE_RESULT_SUCCESS)
+    QueueHandles_.erase(ChipQueue);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  logTrace("Created kernel handle {} of {} for queue {}",
+           (void *)Handle->ZeKernel, HostFName_, (void *)ChipQueue);
+  return *Handle;
+}
+
+void CHIPKernelLevel0::releaseHandle(const CHIPQueue *ChipQueue) {
+  LOCK(QueueHandlesMtx_); // CHIPKernelLevel0::QueueHandles_
+  auto Found = QueueHandles_.find(ChipQueue);
+  if (Found == QueueHandles_.end())
+    return;
+  // ZeKernel_ is destroyed with the kernel.
+  if (Found->second->ZeKernel != ZeKernel_) {
+    ze_result_t Status = zeKernelDestroy(Found->second->ZeKernel);
+    if (Status != ZE_RESULT_SUCCESS)
+      logError("zeKernelDestroy failed: {}", resultToString(Status));
+  }
+  QueueHandles_.erase(Found);
+}
+
+void CHIPKernelLevel0::setGroupSize(CHIPKernelHandleLevel0 &Handle, uint32_t X,
+                                    uint32_t Y, uint32_t Z) {
+  if (Handle.GroupSize[0] == X && Handle.GroupSize[1] == Y &&
+      Handle.GroupSize[2] == Z) {
+    NumGroupSizeSetsSkipped_++;
+    return;
+  }
+
+  ze_result_t Status = zeKernelSetGroupSize(Handle.ZeKernel, X, Y, Z);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  Handle.GroupSize[0] = X;
+  Handle.GroupSize[1] = Y;
+  Handle.GroupSize[2] = Z;
+}
+
 CHIPKernelLevel0::CHIPKernelLevel0(ze_kernel_handle_t ZeKernel,
                                    CHIPDeviceLevel0 *Dev, std::string HostFName,
                                    SPVFuncInfo *FuncInfo,
@@ -762,6 +1112,8 @@ hipError_t CHIPKernelLevel0::getAttributes(hipFuncAttributes *Attr) {
 
 CHIPQueueLevel0::~CHIPQueueLevel0() {
   logTrace("~CHIPQueueLevel0() {}", (void *)this);
+  detachSubmissionWorker();
+  flush();
   // From destructor post query only when queue is owned by CHIP
   // Non-owned command queues can be destroyed independently by the owner
   if (zeCmdQOwnership_) {
@@ -771,39 +1123,59 @@ CHIPQueueLevel0::~CHIPQueueLevel0() {
               // deadlocking while waiting for queue completion and subsequent
               // event status change
   }
+  ChipDevice_->releaseKernelHandles(this);
   updateLastEvent(
       nullptr); // Just in case that unique_ptr destructor calls this, the
                 // generic ~CHIPQueue() (which calls updateLastEvent(nullptr))
                 // hasn't been called yet, and the stale event monitor ends up
                 // waiting forever.
+  if (CHIPEventLevel0 *Dependency = CopyDependency_.exchange(nullptr))
+    Dependency->decreaseRefCount("~CHIPQueueLevel0");
+  delete CopyQueue_.load();
+  for (auto *StripeQueue : StripeQueues_)
+    delete StripeQueue;
+  if (auto *Monitor = ((CHIPBackendLevel0 *)Backend)->getStaleEventMonitor())
+    Monitor->forgetQueue(this);
+  if (auto *Monitor =
+          ((CHIPBackendLevel0 *)Backend)->getCallbackEventMonitor())
+    Monitor->forgetQueue(this);
 
   // The application must not call this function from
   // simultaneous threads with the same command queue handle.
   // Done. Destructor should not be called by multiple threads
 #ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockLevel0)
+  LOCK(ZeCmdQMtx_); // CHIPQueueLevel0::ZeCmdQ_
 #endif
   if (zeCmdQOwnership_) {
     zeCommandQueueDestroy(ZeCmdQ_);
   } else {
     logTrace("CHIP does not own cmd queue");
   }
+  // The command queues used before the queue was moved.
+  for (auto ZeCmdQ : ZeCmdQs_)
+    if (ZeCmdQ && ZeCmdQ != ZeCmdQ_)
+      zeCommandQueueDestroy(ZeCmdQ);
+  Placement_->Load->release(Placement_->Index);
 }
 
 void CHIPQueueLevel0::addCallback(hipStreamCallback_t Callback,
                                   void *UserData) {
+  waitForSubmissions();
   CHIPCallbackData *Callbackdata =
       Backend->createCallbackData(Callback, UserData, this);
+  // The callback workers wait for the commands enqueued above.
+  flush();
 
   {
     LOCK(Backend->CallbackQueueMtx); // CHIPBackend::CallbackQueue
     Backend->CallbackQueue.push(Callbackdata);
   }
-
+  Backend->CallbackQueueCond.notify_one();
   return;
 }
 
 CHIPEventLevel0 *CHIPQueueLevel0::getLastEvent() {
+  waitForSubmissions();
   LOCK(LastEventMtx); // CHIPQueue::LastEvent_
   return (CHIPEventLevel0 *)LastEvent_;
 }
@@ -812,18 +1184,232 @@ ze_command_list_handle_t CHIPQueueLevel0::getCmdList() {
 #ifdef L0_IMM_QUEUES
   return ZeCmdList_;
 #else
-  ze_command_list_handle_t ZeCmdList;
-#ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockLevel0)
-#endif
-  auto Status =
-      zeCommandListCreate(ZeCtx_, ZeDev_, &CommandListDesc_, &ZeCmdList);
-  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS,
-                              hipErrorInitializationError);
+  // BatchMtx_ is held via GET_COMMAND_LIST
+  ze_command_list_handle_t ZeCmdList = BatchCmdList_;
+  if (!ZeCmdList) {
+    ZeCmdList = CmdListPool_->acquire();
+    if (isBatching()) {
+      BatchCmdList_ = ZeCmdList;
+      BatchOpenTime_ = std::chrono::steady_clock::now();
+    }
+  } else if (BatchNeedsBarrier_) {
+    ze_result_t Status =
+        zeCommandListAppendBarrier(ZeCmdList, nullptr, 0, nullptr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    BatchNeedsBarrier_ = false;
+  }
+  waitForCopyQueueNoLock(ZeCmdList);
   return ZeCmdList;
 #endif
 }
 
+CHIPQueueLevel0 *CHIPQueueLevel0::getCopyQueue() {
+#ifdef L0_IMM_QUEUES
+  return nullptr;
+#else
+  if (CHIPQueueLevel0 *CopyQueue = CopyQueue_.load())
+    return CopyQueue;
+  auto *ChipDevLz = (CHIPDeviceLevel0 *)ChipDevice_;
+  if (!CHIPCopyQueue || QueueType != LevelZeroQueueType::Compute ||
+      !ChipDevLz->copyQueueIsAvailable())
+    return nullptr;
+
+  LOCK(CopyQueueMtx_); // CHIPQueueLevel0::CopyQueue_
+  if (!CopyQueue_) {
+    logTrace("Creating a copy queue for {}", (void *)this);
+    // The engine affinity refers to the compute queues.
+    auto *CopyQueue =
+        new CHIPQueueLevel0(ChipDevLz, QueueFlags_.withoutEngineAffinity(),
+                            Priority_, LevelZeroQueueType::Copy);
+    // The copies are waited for by the commands of this queue so they are
+    // submitted right away.
+    CopyQueue->MaxBatchSize_ = 1;
+    CopyQueue_ = CopyQueue;
+  }
+  return CopyQueue_;
+#endif
+}
+
+void CHIPQueueLevel0::waitForCopyQueueNoLock(
+    ze_command_list_handle_t CommandList) {
+  CHIPEventLevel0 *Dependency = CopyDependency_.exchange(nullptr);
+  if (!Dependency)
+    return;
+  if (Dependency->isFinished()) {
+    Dependency->decreaseRefCount("copy dependency finished");
+    return;
+  }
+
+  ze_event_handle_t WaitEvent = Dependency->peek();
+  // The application must not call this function from
+  // simultaneous threads with the same command list handle.
+  // Done via BatchMtx_
+  auto Status = zeCommandListAppendBarrier(CommandList, nullptr, 1, &WaitEvent);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  CmdListDependencies_.push_back(Dependency);
+}
+
+template <typename AppendFn>
+CHIPEvent *CHIPQueueLevel0::enqueueOnCopyQueue(
+    CHIPQueueLevel0 *CopyQueue, const char *Msg, AppendFn Append,
+    const std::vector<CHIPEventLevel0 *> &Dependencies) {
+  CHIPEventLevel0 *Ev = (CHIPEventLevel0 *)Backend->createCHIPEvent(
+      ChipContext_);
+  Ev->Msg = Msg;
+  for (auto *Dependency : Dependencies)
+    Ev->addDependency(Dependency);
+
+  // Wait for the preceding commands of this queue. Getting the last event
+  // submits them if they are batched.
+  ze_event_handle_t WaitEvent = nullptr;
+  if (auto *Last = (CHIPEventLevel0 *)acquireLastEvent()) {
+    if (Last->isFinished()) {
+      Last->decreaseRefCount("enqueueOnCopyQueue");
+    } else {
+      WaitEvent = Last->peek();
+      // Keeps the event alive until the copy has finished.
+      Ev->addDependency(Last);
+    }
+  }
+
+  {
+    GET_COMMAND_LIST(CopyQueue)
+    // The application must not call this function from
+    // simultaneous threads with the same command list handle.
+    // Done via GET_COMMAND_LIST
+    ze_result_t Status = Append(CommandList, Ev->peek(), WaitEvent ? 1 : 0,
+                                WaitEvent ? &WaitEvent : nullptr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    CopyQueue->executeCommandList(CommandList, Ev);
+  }
+
+  // The next command of this queue waits for the copy.
+  Ev->increaseRefCount("CopyDependency_");
+  if (CHIPEventLevel0 *Old = CopyDependency_.exchange(Ev))
+    Old->decreaseRefCount("CopyDependency_ replaced");
+  return Ev;
+}
+
+std::vector<CHIPQueueLevel0 *>
+CHIPQueueLevel0::getStripeQueues(CHIPQueueLevel0 *CopyQueue, size_t Size) {
+  auto *BackendLz = (CHIPBackendLevel0 *)Backend;
+  size_t ChunkSize = BackendLz->CopyChunkSize;
+  if (!ChunkSize || Size <= ChunkSize)
+    return {};
+  auto *ChipDevLz = (CHIPDeviceLevel0 *)ChipDevice_;
+  size_t NumEngines = ChipDevLz->getCopyQueueProps().numQueues;
+  if (BackendLz->MaxCopyEngines)
+    NumEngines = std::min(NumEngines, BackendLz->MaxCopyEngines);
+  size_t NumChunks = (Size + ChunkSize - 1) / ChunkSize;
+  size_t NumQueues = std::min(NumEngines, NumChunks);
+  if (NumQueues < 2)
+    return {};
+
+  LOCK(CopyQueueMtx_); // CHIPQueueLevel0::StripeQueues_
+  while (StripeQueues_.size() + 1 < NumQueues) {
+    // New queues go to the least loaded queue index of the group so the
+    // stripes end up on different engines.
+    auto *StripeQueue =
+        new CHIPQueueLevel0(ChipDevLz, QueueFlags_.withoutEngineAffinity(),
+                            Priority_, LevelZeroQueueType::Copy);
+    StripeQueue->MaxBatchSize_ = 1;
+    // Moving could bring stripes together on one engine.
+    StripeQueue->Pinned_ = true;
+    StripeQueues_.push_back(StripeQueue);
+  }
+  std::vector<CHIPQueueLevel0 *> Queues{CopyQueue};
+  Queues.insert(Queues.end(), StripeQueues_.begin(),
+                StripeQueues_.begin() + (NumQueues - 1));
+  return Queues;
+}
+
+CHIPEvent *CHIPQueueLevel0::enqueueStripedCopy(
+    const std::vector<CHIPQueueLevel0 *> &Queues, void *Dst, const void *Src,
+    size_t Size) {
+  size_t ChunkSize = ((CHIPBackendLevel0 *)Backend)->CopyChunkSize;
+  size_t Stride = ChunkSize * Queues.size();
+  logTrace("Striping a copy of {} B across {} copy queues", Size,
+           Queues.size());
+
+  // Append the chunks of the stripe 'Idx' after the events to wait for.
+  // The copies of a command list may run out of order so barriers order
+  // them with the commands around them.
+  auto AppendChunks = [&](ze_command_list_handle_t CommandList, size_t Idx,
+                          uint32_t NumWaitEvents,
+                          ze_event_handle_t *WaitEvents) {
+    ze_result_t Status = ZE_RESULT_SUCCESS;
+    if (NumWaitEvents)
+      Status = zeCommandListAppendBarrier(CommandList, nullptr, NumWaitEvents,
+                                          WaitEvents);
+    for (size_t Offset = Idx * ChunkSize;
+         Offset < Size && Status == ZE_RESULT_SUCCESS; Offset += Stride)
+      Status = zeCommandListAppendMemoryCopy(
+          CommandList, (char *)Dst + Offset, (const char *)Src + Offset,
+          std::min(ChunkSize, Size - Offset), nullptr, 0, nullptr);
+    return Status;
+  };
+
+  // The stripes on the other queues wait for the preceding commands of
+  // this queue and signal an event each.
+  ze_event_handle_t WaitEvent = nullptr;
+  auto *Last = (CHIPEventLevel0 *)acquireLastEvent();
+  if (Last && Last->isFinished()) {
+    Last->decreaseRefCount("enqueueStripedCopy");
+    Last = nullptr;
+  }
+  if (Last)
+    WaitEvent = Last->peek();
+
+  std::vector<CHIPEventLevel0 *> StripeEvents;
+  std::vector<ze_event_handle_t> StripeHandles;
+  for (size_t Idx = 1; Idx < Queues.size(); Idx++) {
+    auto *StripeEvent =
+        (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipContext_);
+    StripeEvent->Msg = "memCopyStripe";
+    if (Last) {
+      // Keeps the event alive until the stripe has finished. Each stripe
+      // waits for it on its own engine, so each holds a reference. The
+      // first one takes over the reference of acquireLastEvent().
+      if (Idx > 1)
+        Last->increaseRefCount("enqueueStripedCopy");
+      StripeEvent->addDependency(Last);
+    }
+
+    GET_COMMAND_LIST(Queues[Idx])
+    // The application must not call this function from
+    // simultaneous threads with the same command list handle.
+    // Done via GET_COMMAND_LIST
+    ze_result_t Status = AppendChunks(CommandList, Idx, WaitEvent ? 1 : 0,
+                                      WaitEvent ? &WaitEvent : nullptr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    Status = zeCommandListAppendBarrier(CommandList, StripeEvent->peek(), 0,
+                                        nullptr);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    Queues[Idx]->executeCommandList(CommandList, StripeEvent);
+    // The stripe retires on its own, which releases its dependencies, and
+    // the joining copy holds a second reference.
+    StripeEvent->increaseRefCount("memCopyStripe join");
+    StripeEvent->track();
+    StripeEvents.push_back(StripeEvent);
+    StripeHandles.push_back(StripeEvent->peek());
+  }
+
+  // The first stripe joins the others with the event of the copy.
+  return enqueueOnCopyQueue(
+      Queues[0], "memCopyAsync",
+      [&](ze_command_list_handle_t CommandList, ze_event_handle_t Signal,
+          uint32_t NumWaitEvents, ze_event_handle_t *WaitEvents) {
+        ze_result_t Status =
+            AppendChunks(CommandList, 0, NumWaitEvents, WaitEvents);
+        if (Status != ZE_RESULT_SUCCESS)
+          return Status;
+        return zeCommandListAppendBarrier(CommandList, Signal,
+                                          StripeHandles.size(),
+                                          StripeHandles.data());
+      },
+      StripeEvents);
+}
+
 CHIPQueueLevel0::CHIPQueueLevel0(CHIPDeviceLevel0 *ChipDev)
     : CHIPQueueLevel0(ChipDev, 0, L0_DEFAULT_QUEUE_PRIORITY,
                       LevelZeroQueueType::Compute) {}
@@ -847,40 +1433,47 @@ CHIPQueueLevel0::CHIPQueueLevel0(CHIPDeviceLevel0 *ChipDev,
   auto Ctx = ChipDevLz->getContext();
   auto ChipContextLz = (CHIPContextLevel0 *)Ctx;
 
+  int Affinity = Flags.getEngineAffinity();
   if (TheType == Compute) {
     QueueProperties_ = ChipDev->getComputeQueueProps();
-    QueueDescriptor_ = ChipDev->getNextComputeQueueDesc(Priority);
+    QueueDescriptor_ = ChipDev->getNextComputeQueueDesc(Priority, Affinity);
     CommandListDesc_ = ChipDev->getCommandListComputeDesc();
   } else if (TheType == Copy) {
     QueueProperties_ = ChipDev->getCopyQueueProps();
-    QueueDescriptor_ = ChipDev->getNextCopyQueueDesc(Priority);
+    QueueDescriptor_ = ChipDev->getNextCopyQueueDesc(Priority, Affinity);
     CommandListDesc_ = ChipDev->getCommandListCopyDesc();
 
   } else {
     CHIPERR_LOG_AND_THROW("Unknown queue type requested", hipErrorTbd);
   }
   QueueType = TheType;
-
-  SharedBuf_ =
-      ChipContextLz->allocateImpl(32, 8, hipMemoryType::hipMemoryTypeUnified);
-
-  // Initialize the uint64_t part as 0
-  *(uint64_t *)this->SharedBuf_ = 0;
+  Placement_ = std::make_shared<LZQueuePlacement>(
+      &ChipDev->getQueueGroupLoad(TheType), QueueDescriptor_.index);
+  Pinned_ = Affinity >= 0;
 
   ZeCtx_ = ChipContextLz->get();
   ZeDev_ = ChipDevLz->get();
 
   logTrace("CHIPQueueLevel0 constructor called via Flags and Priority");
-#ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockLevel0)
-#endif
-  Status = zeCommandQueueCreate(ZeCtx_, ZeDev_, &QueueDescriptor_, &ZeCmdQ_);
+  ze_command_queue_handle_t ZeCmdQ;
+  Status = zeCommandQueueCreate(ZeCtx_, ZeDev_, &QueueDescriptor_, &ZeCmdQ);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS,
                               hipErrorInitializationError);
+  ZeCmdQ_ = ZeCmdQ;
+  ZeCmdQs_.resize(QueueProperties_.numQueues);
+  ZeCmdQs_[QueueDescriptor_.index] = ZeCmdQ;
 
 #ifdef L0_IMM_QUEUEs
   initializeCmdListImm();
 #endif
+
+#ifndef L0_IMM_QUEUES
+  MaxBatchSize_ = ((CHIPBackendLevel0 *)Backend)->MaxBatchSize;
+  MaxBatchLatency_ = ((CHIPBackendLevel0 *)Backend)->MaxBatchLatency;
+  CmdListPool_ = std::make_shared<LZCommandListPool>(
+      ZeCtx_, ZeDev_, CommandListDesc_,
+      ((CHIPBackendLevel0 *)Backend)->MaxCommandListPoolSize);
+#endif
 }
 
 CHIPQueueLevel0::CHIPQueueLevel0(CHIPDeviceLevel0 *ChipDev,
@@ -893,6 +1486,12 @@ CHIPQueueLevel0::CHIPQueueLevel0(CHIPDeviceLevel0 *ChipDev,
   QueueProperties_ = ChipDev->getComputeQueueProps();
   QueueDescriptor_ = ChipDev->getNextComputeQueueDesc();
   CommandListDesc_ = ChipDev->getCommandListComputeDesc();
+  // The hardware queue of a native queue is not known so it only counts
+  // towards the load of the index it was given.
+  Placement_ = std::make_shared<LZQueuePlacement>(
+      &ChipDev->getQueueGroupLoad(LevelZeroQueueType::Compute),
+      QueueDescriptor_.index);
+  Pinned_ = true;
 
   ZeCtx_ = ChipContextLz->get();
   ZeDev_ = ChipDevLz->get();
@@ -901,6 +1500,10 @@ CHIPQueueLevel0::CHIPQueueLevel0(CHIPDeviceLevel0 *ChipDev,
 
 #ifdef L0_IMM_QUEUES
   initializeCmdListImm();
+#else
+  CmdListPool_ = std::make_shared<LZCommandListPool>(
+      ZeCtx_, ZeDev_, CommandListDesc_,
+      ((CHIPBackendLevel0 *)Backend)->MaxCommandListPoolSize);
 #endif
 }
 
@@ -961,8 +1564,12 @@ void CHIPDeviceLevel0::initializeQueueGroupProperties() {
     }
   }
 
-  // initialize compute and copy list descriptors
   assert(ComputeQueueGroupOrdinal_ > -1);
+  ComputeLoad_.init(ComputeQueueProperties_.numQueues);
+  if (CopyQueueAvailable_)
+    CopyLoad_.init(CopyQueueProperties_.numQueues);
+
+  // initialize compute and copy list descriptors
   CommandListComputeDesc_ = {
       ZE_STRUCTURE_TYPE_COMMAND_LIST_DESC,
       nullptr,
@@ -1008,29 +1615,22 @@ ze_command_queue_desc_t CHIPDeviceLevel0::getQueueDesc_(int Priority) {
 }
 
 ze_command_queue_desc_t
-CHIPDeviceLevel0::getNextComputeQueueDesc(int Priority) {
+CHIPDeviceLevel0::getNextComputeQueueDesc(int Priority, int Affinity) {
 
   assert(ComputeQueueGroupOrdinal_ > -1);
   ze_command_queue_desc_t CommandQueueComputeDesc = getQueueDesc_(Priority);
   CommandQueueComputeDesc.ordinal = ComputeQueueGroupOrdinal_;
-
-  auto MaxQueues = ComputeQueueProperties_.numQueues;
-  LOCK(NextQueueIndexMtx_); // CHIPDeviceLevel0::NextComputeQueueIndex_
-  CommandQueueComputeDesc.index = NextComputeQueueIndex_;
-  NextComputeQueueIndex_ = (NextComputeQueueIndex_ + 1) % MaxQueues;
+  CommandQueueComputeDesc.index = ComputeLoad_.acquire(Affinity);
 
   return CommandQueueComputeDesc;
 }
 
-ze_command_queue_desc_t CHIPDeviceLevel0::getNextCopyQueueDesc(int Priority) {
+ze_command_queue_desc_t CHIPDeviceLevel0::getNextCopyQueueDesc(int Priority,
+                                                               int Affinity) {
   assert(CopyQueueGroupOrdinal_ > -1);
   ze_command_queue_desc_t CommandQueueCopyDesc = getQueueDesc_(Priority);
   CommandQueueCopyDesc.ordinal = CopyQueueGroupOrdinal_;
-
-  auto MaxQueues = CopyQueueProperties_.numQueues;
-  LOCK(NextQueueIndexMtx_); // CHIPDeviceLevel0::NextCopyQueueIndex_
-  CommandQueueCopyDesc.index = NextCopyQueueIndex_;
-  NextCopyQueueIndex_ = (NextCopyQueueIndex_ + 1) % MaxQueues;
+  CommandQueueCopyDesc.index = CopyLoad_.acquire(Affinity);
 
   return CommandQueueCopyDesc;
 }
@@ -1042,19 +1642,15 @@ CHIPEvent *CHIPQueueLevel0::launchImpl(CHIPExecItem *ExecItem) {
   LaunchEvent->Msg = "launch";
 
   CHIPKernelLevel0 *ChipKernel = (CHIPKernelLevel0 *)ExecItem->getKernel();
-  ze_kernel_handle_t KernelZe = ChipKernel->get();
+  // zeKernelSetGroupSize and zeKernelSetArgumentValue must not be called from
+  // simultaneous threads with the same kernel handle. The handle is private
+  // to this queue and the caller holds LaunchMtx.
+  auto &KernelHandle = ChipKernel->getHandle(this);
+  ze_kernel_handle_t KernelZe = KernelHandle.ZeKernel;
   logTrace("Launching Kernel {}", ChipKernel->getName());
 
-  {
-    LOCK(ExecItem->ExecItemMtx) // required by zeKernelSetGroupSize
-    // The application must not call this function from
-    // simultaneous threads with the same kernel handle.
-    // Done by locking ExecItemMtx
-    ze_result_t Status =
-        zeKernelSetGroupSize(KernelZe, ExecItem->getBlock().x,
-                             ExecItem->getBlock().y, ExecItem->getBlock().z);
-    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  }
+  ChipKernel->setGroupSize(KernelHandle, ExecItem->getBlock().x,
+                           ExecItem->getBlock().y, ExecItem->getBlock().z);
 
   ExecItem->setupAllArgs();
   auto X = ExecItem->getGrid().x;
@@ -1073,14 +1669,7 @@ CHIPEvent *CHIPQueueLevel0::launchImpl(CHIPExecItem *ExecItem) {
   if (StatusReadyCheck != ZE_RESULT_NOT_READY) {
     logCritical("KernelLaunch event immediately ready!");
   }
-  executeCommandList(CommandList);
-
-  if (std::shared_ptr<CHIPArgSpillBuffer> SpillBuf =
-          ExecItem->getArgSpillBuffer())
-    // Use an event action to prolong the lifetime of the spill buffer
-    // in case the exec item gets destroyed before the kernel
-    // completes (may happen when called from CHIPQueue::launchKernel()).
-    LaunchEvent->addAction([=]() -> void { auto Tmp = SpillBuf; });
+  executeCommandList(CommandList, LaunchEvent);
 
   LaunchEvent->track();
   return LaunchEvent;
@@ -1089,10 +1678,6 @@ CHIPEvent *CHIPQueueLevel0::launchImpl(CHIPExecItem *ExecItem) {
 CHIPEvent *CHIPQueueLevel0::memFillAsyncImpl(void *Dst, size_t Size,
                                              const void *Pattern,
                                              size_t PatternSize) {
-  CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
-  CHIPEventLevel0 *Ev = (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipCtxZe);
-  Ev->Msg = "memFill";
-
   // Check that requested pattern is a power of 2
   if (std::ceil(log2(PatternSize)) != std::floor(log2(PatternSize))) {
     logCritical("PatternSize: {} Max: {}", PatternSize,
@@ -1109,6 +1694,21 @@ CHIPEvent *CHIPQueueLevel0::memFillAsyncImpl(void *Dst, size_t Size,
                           hipErrorTbd);
   }
 
+  CHIPQueueLevel0 *CopyQueue = getCopyQueue();
+  if (CopyQueue && PatternSize <= CopyQueue->getMaxMemoryFillPatternSize())
+    return enqueueOnCopyQueue(
+        CopyQueue, "memFill",
+        [&](ze_command_list_handle_t CommandList, ze_event_handle_t Signal,
+            uint32_t NumWaitEvents, ze_event_handle_t *WaitEvents) {
+          return zeCommandListAppendMemoryFill(CommandList, Dst, Pattern,
+                                               PatternSize, Size, Signal,
+                                               NumWaitEvents, WaitEvents);
+        });
+
+  CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
+  CHIPEventLevel0 *Ev = (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipCtxZe);
+  Ev->Msg = "memFill";
+
   GET_COMMAND_LIST(this);
   // The application must not call this function from
   // simultaneous threads with the same command list handle.
@@ -1116,7 +1716,7 @@ CHIPEvent *CHIPQueueLevel0::memFillAsyncImpl(void *Dst, size_t Size,
   ze_result_t Status = zeCommandListAppendMemoryFill(
       CommandList, Dst, Pattern, PatternSize, Size, Ev->peek(), 0, nullptr);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  executeCommandList(CommandList);
+  executeCommandList(CommandList, Ev);
 
   return Ev;
 };
@@ -1132,10 +1732,6 @@ CHIPEvent *CHIPQueueLevel0::memCopy3DAsyncImpl(void *Dst, size_t Dpitch,
                                                size_t Spitch, size_t Sspitch,
                                                size_t Width, size_t Height,
                                                size_t Depth) {
-  CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
-  CHIPEventLevel0 *Ev = (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipCtxZe);
-  Ev->Msg = "memCopy3DAsync";
-
   ze_copy_region_t DstRegion;
   DstRegion.originX = 0;
   DstRegion.originY = 0;
@@ -1150,6 +1746,21 @@ CHIPEvent *CHIPQueueLevel0::memCopy3DAsyncImpl(void *Dst, size_t Dpitch,
   SrcRegion.width = Width;
   SrcRegion.height = Height;
   SrcRegion.depth = Depth;
+
+  if (CHIPQueueLevel0 *CopyQueue = getCopyQueue())
+    return enqueueOnCopyQueue(
+        CopyQueue, "memCopy3DAsync",
+        [&](ze_command_list_handle_t CommandList, ze_event_handle_t Signal,
+            uint32_t NumWaitEvents, ze_event_handle_t *WaitEvents) {
+          return zeCommandListAppendMemoryCopyRegion(
+              CommandList, Dst, &DstRegion, Dpitch, Dspitch, Src, &SrcRegion,
+              Spitch, Sspitch, Signal, NumWaitEvents, WaitEvents);
+        });
+
+  CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
+  CHIPEventLevel0 *Ev = (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipCtxZe);
+  Ev->Msg = "memCopy3DAsync";
+
   GET_COMMAND_LIST(this);
   // The application must not call this function from
   // simultaneous threads with the same command list handle.
@@ -1158,7 +1769,7 @@ CHIPEvent *CHIPQueueLevel0::memCopy3DAsyncImpl(void *Dst, size_t Dpitch,
       CommandList, Dst, &DstRegion, Dpitch, Dspitch, Src, &SrcRegion, Spitch,
       Sspitch, Ev->peek(), 0, nullptr);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  executeCommandList(CommandList);
+  executeCommandList(CommandList, Ev);
 
   return Ev;
 };
@@ -1168,6 +1779,7 @@ CHIPEvent *CHIPQueueLevel0::memCopyToImage(ze_image_handle_t Image,
                                            const void *Src,
                                            const CHIPRegionDesc &SrcRegion) {
   logTrace("CHIPQueueLevel0::memCopyToImage");
+  waitForSubmissions();
   CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
   CHIPEventLevel0 *Ev = (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipCtxZe);
   Ev->Msg = "memCopyToImage";
@@ -1181,7 +1793,7 @@ CHIPEvent *CHIPQueueLevel0::memCopyToImage(ze_image_handle_t Image,
         CommandList, Image, Src, 0,
         Ev->get("zeCommandListAppendImageCopyFromMemory"), 0, nullptr);
     CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-    executeCommandList(CommandList);
+    executeCommandList(CommandList, Ev);
 
     return Ev;
   }
@@ -1209,7 +1821,7 @@ CHIPEvent *CHIPQueueLevel0::memCopyToImage(ze_image_handle_t Image,
         LastRow ? Ev->get("zeCommandListAppendImageCopyFromMemory") : nullptr,
         0, nullptr);
     CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-    executeCommandList(CommandList);
+    executeCommandList(CommandList, LastRow ? Ev : nullptr);
     SrcRow += SrcRegion.Pitch[0];
   }
   return Ev;
@@ -1218,14 +1830,16 @@ CHIPEvent *CHIPQueueLevel0::memCopyToImage(ze_image_handle_t Image,
 hipError_t CHIPQueueLevel0::getBackendHandles(uintptr_t *NativeInfo,
                                               int *NumHandles) {
   logTrace("CHIPQueueLevel0::getBackendHandles");
+  waitForSubmissions();
   if (*NumHandles < 4) {
     logError("getBackendHandles requires space for 4 handles");
     return hipErrorInvalidValue;
   }
   *NumHandles = 4;
 
-  // Get queue handler
-  NativeInfo[3] = (uintptr_t)ZeCmdQ_;
+  // Get queue handler. The queue must not move once its handle is out.
+  Pinned_ = true;
+  NativeInfo[3] = (uintptr_t)ZeCmdQ_.load();
 
   // Get context handler
   CHIPContextLevel0 *Ctx = (CHIPContextLevel0 *)ChipContext_;
@@ -1254,7 +1868,7 @@ CHIPEvent *CHIPQueueLevel0::enqueueMarkerImpl() {
       CommandList,
       MarkerEvent->get("MarkerEvent: zeCommandListAppendSignalEvent"));
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  executeCommandList(CommandList);
+  executeCommandList(CommandList, MarkerEvent);
 
   return MarkerEvent;
 }
@@ -1279,6 +1893,10 @@ CHIPQueueLevel0::enqueueBarrierImpl(std::vector<CHIPEvent *> *EventsToWaitFor) {
     for (size_t i = 0; i < NumEventsToWaitFor; i++) {
       CHIPEventLevel0 *ChipEventLz = (CHIPEventLevel0 *)(*EventsToWaitFor)[i];
       CHIPASSERT(ChipEventLz);
+      // A batched command on another queue must be submitted before this
+      // queue can wait for it. This must be done before GET_COMMAND_LIST.
+      if (!ChipEventLz->isBatchPendingOn(this))
+        ChipEventLz->flushBatch();
       EventHandles[i] = ChipEventLz->get("enqueueBarrierImpl addDependency");
       EventToSignal->addDependency(ChipEventLz);
     }
@@ -1292,7 +1910,7 @@ CHIPQueueLevel0::enqueueBarrierImpl(std::vector<CHIPEvent *> *EventsToWaitFor) {
   auto Status = zeCommandListAppendBarrier(CommandList, SignalEventHandle,
                                            NumEventsToWaitFor, EventHandles);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  executeCommandList(CommandList);
+  executeCommandList(CommandList, EventToSignal);
 
   if (EventHandles)
     delete[] EventHandles;
@@ -1303,6 +1921,20 @@ CHIPQueueLevel0::enqueueBarrierImpl(std::vector<CHIPEvent *> *EventsToWaitFor) {
 CHIPEvent *CHIPQueueLevel0::memCopyAsyncImpl(void *Dst, const void *Src,
                                              size_t Size) {
   logTrace("CHIPQueueLevel0::memCopyAsync");
+  if (CHIPQueueLevel0 *CopyQueue = getCopyQueue()) {
+    auto StripeQueues = getStripeQueues(CopyQueue, Size);
+    if (!StripeQueues.empty())
+      return enqueueStripedCopy(StripeQueues, Dst, Src, Size);
+    return enqueueOnCopyQueue(
+        CopyQueue, "memCopyAsync",
+        [&](ze_command_list_handle_t CommandList, ze_event_handle_t Signal,
+            uint32_t NumWaitEvents, ze_event_handle_t *WaitEvents) {
+          return zeCommandListAppendMemoryCopy(CommandList, Dst, Src, Size,
+                                               Signal, NumWaitEvents,
+                                               WaitEvents);
+        });
+  }
+
   CHIPContextLevel0 *ChipCtxZe = (CHIPContextLevel0 *)ChipContext_;
   CHIPEventLevel0 *MemCopyEvent =
       (CHIPEventLevel0 *)Backend->createCHIPEvent(ChipCtxZe);
@@ -1317,66 +1949,219 @@ CHIPEvent *CHIPQueueLevel0::memCopyAsyncImpl(void *Dst, const void *Src,
                                          MemCopyEvent->peek(), 0, nullptr);
   CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS,
                               hipErrorInitializationError);
-  executeCommandList(CommandList);
+  executeCommandList(CommandList, MemCopyEvent);
 
   return MemCopyEvent;
 }
 
 void CHIPQueueLevel0::finish() {
-  // The finish Event_ that denotes the finish of current command list items
-  pthread_yield();
+  waitForSubmissions();
+  size_t Seq = Timeline_->getSubmitted();
+  // The hardware queue which the work so far was submitted to. The queue
+  // may only move to another one once that work has completed.
+  ze_command_queue_handle_t ZeCmdQ;
+  {
+    LOCK(BatchMtx_); // CHIPQueueLevel0::BatchCmdList_, ZeCmdQ_
+    flushBatchNoLock();
+    ZeCmdQ = ZeCmdQ_;
+  }
+  if (CHIPQueueLevel0 *CopyQueue = CopyQueue_.load())
+    CopyQueue->finish();
   // Using zeCommandQueueSynchronize() for ensuring the device printf
   // buffers get flushed.
-#ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockLevel0)
-#endif
-  zeCommandQueueSynchronize(ZeCmdQ_, UINT64_MAX);
+  auto QueryQueue = [&]() {
+    return zeCommandQueueSynchronize(ZeCmdQ, 0) != ZE_RESULT_NOT_READY;
+  };
+  // zeCommandQueueSynchronize() is thread-safe, so neither the polling nor
+  // the blocking wait holds a lock and other threads can keep submitting to
+  // the queue meanwhile.
+  ChipDevice_->synchronize(
+      QueryQueue, [&]() { zeCommandQueueSynchronize(ZeCmdQ, UINT64_MAX); });
+  Timeline_->complete(Seq);
+}
 
-  return;
+void CHIPQueueLevel0::drainPrintfBuffers() {
+  // Level Zero outputs the device printf buffers on a queue synchronization.
+  // A zero timeout doesn't wait for commands submitted meanwhile.
+  zeCommandQueueSynchronize(ZeCmdQ_, 0);
 }
 
-void CHIPQueueLevel0::executeCommandList(ze_command_list_handle_t CommandList) {
+void CHIPQueueLevel0::flush() {
+  LOCK(BatchMtx_); // CHIPQueueLevel0::BatchCmdList_
+  flushBatchNoLock();
+}
+
+void CHIPQueueLevel0::forgetBatchedEvent(CHIPEventLevel0 *Event) {
+  LOCK(BatchMtx_); // CHIPQueueLevel0::BatchedEvents_
+  BatchedEvents_.erase(
+      std::remove(BatchedEvents_.begin(), BatchedEvents_.end(), Event),
+      BatchedEvents_.end());
+  Event->setBatchQueue(nullptr);
+}
+
+void CHIPQueueLevel0::flushBatchNoLock() {
+  if (!BatchCmdList_)
+    return;
+
+  logTrace("Submitting a batch of {} commands on queue {}",
+           NumBatchedCommands_, (void *)this);
+  submitCommandList(BatchCmdList_);
+  // The events may be waited on once the batch is submitted.
+  for (auto *Event : BatchedEvents_)
+    if (Event->isBatchPendingOn(this))
+      Event->setBatchQueue(nullptr);
+  BatchedEvents_.clear();
+  BatchCmdList_ = nullptr;
+  NumBatchedCommands_ = 0;
+  BatchNeedsBarrier_ = false;
+
+  // The stale event monitor may be waiting for the batch.
+  if (auto *Monitor = ((CHIPBackendLevel0 *)Backend)->getStaleEventMonitor())
+    Monitor->batchSubmitted(this);
+}
+
+void CHIPQueueLevel0::executeCommandList(ze_command_list_handle_t CommandList,
+                                         CHIPEventLevel0 *SignalEvent) {
+  if (SignalEvent)
+    SignalEvent->setSubmitQueue(this);
 #ifdef L0_IMM_QUEUES
 #else
+  // BatchMtx_ is held via GET_COMMAND_LIST
+  if (CommandList != BatchCmdList_) {
+    assert(!isBatching());
+    submitCommandList(CommandList);
+    return;
+  }
 
-  auto LastCmdListEvent =
-      ((CHIPBackendLevel0 *)Backend)->createCHIPEvent(ChipContext_);
-  LastCmdListEvent->Msg = "CmdListFinishTracker";
+  NumBatchedCommands_++;
+  BatchNeedsBarrier_ = true;
+  if (SignalEvent) {
+    SignalEvent->setBatchQueue(this);
+    BatchedEvents_.push_back(SignalEvent);
+  }
+  // A queue which doesn't batch submits the command along with the event
+  // recordings preceding it.
+  if (!isBatching() || NumBatchedCommands_ >= MaxBatchSize_ ||
+      std::chrono::steady_clock::now() - BatchOpenTime_ >= MaxBatchLatency_)
+    flushBatchNoLock();
+#endif
+}
 
+void CHIPQueueLevel0::appendEventRecord(CHIPEventLevel0 *Event) {
+  // The recording must follow the deferred operations of the queue.
+  waitForSubmissions();
+  Event->setSubmitQueue(this);
+#ifdef L0_IMM_QUEUES
+  GET_COMMAND_LIST(this)
+  // The application must not call this function from
+  // simultaneous threads with the same command list handle.
+  // Done via GET_COMMAND_LIST
+  Event->appendSignal(CommandList);
+#else
+  LOCK(BatchMtx_); // CHIPQueueLevel0::BatchCmdList_
+  if (!BatchCmdList_) {
+    BatchCmdList_ = CmdListPool_->acquire();
+    BatchOpenTime_ = std::chrono::steady_clock::now();
+  }
+  waitForCopyQueueNoLock(BatchCmdList_);
+
+  // The application must not call this function from
+  // simultaneous threads with the same command list handle.
+  // Done via BatchMtx_
+  bool EndsWithBarrier = Event->appendSignal(BatchCmdList_);
+
+  NumBatchedCommands_++;
+  // A trailing barrier orders the commands appended after it.
+  BatchNeedsBarrier_ = !EndsWithBarrier;
+  Event->setBatchQueue(this);
+  BatchedEvents_.push_back(Event);
+
+  if (isBatching() &&
+      (NumBatchedCommands_ >= MaxBatchSize_ ||
+       std::chrono::steady_clock::now() - BatchOpenTime_ >= MaxBatchLatency_))
+    flushBatchNoLock();
+#endif
+}
+
+void CHIPQueueLevel0::rebalanceNoLock() {
+  // Moving is safe only while nothing runs on the current hardware queue,
+  // otherwise the order of the commands would be lost.
+  if (Pinned_ || Placement_->NumInFlight)
+    return;
+  uint32_t Index = Placement_->Index;
+  uint32_t NewIndex = Placement_->Load->rebalance(Index);
+  if (NewIndex == Index)
+    return;
+
+  logDebug("Moving idle queue {} from hardware queue {} to {}", (void *)this,
+           Index, NewIndex);
+  if (!ZeCmdQs_[NewIndex]) {
+    ze_command_queue_desc_t QueueDesc = QueueDescriptor_;
+    QueueDesc.index = NewIndex;
+    auto Status =
+        zeCommandQueueCreate(ZeCtx_, ZeDev_, &QueueDesc, &ZeCmdQs_[NewIndex]);
+    if (Status != ZE_RESULT_SUCCESS) {
+      // Stay where we are.
+      logWarn("zeCommandQueueCreate failed: {}", resultToString(Status));
+      ZeCmdQs_[NewIndex] = nullptr;
+      Placement_->Load->release(NewIndex);
+      Placement_->Load->acquire(Index);
+      return;
+    }
+  }
+  QueueDescriptor_.index = NewIndex;
+  Placement_->Index = NewIndex;
+  ZeCmdQ_ = ZeCmdQs_[NewIndex];
+}
+
+void CHIPQueueLevel0::submitCommandList(ze_command_list_handle_t CommandList) {
   ze_result_t Status;
+  rebalanceNoLock();
 
+  // The commands of a regular command list may complete out of order, so
+  // the event of the last command does not tell that the list has
+  // finished. A trailing barrier does.
+  CHIPEventLevel0 *LastCmdListEvent =
+      ((CHIPBackendLevel0 *)Backend)->createCHIPEvent(ChipContext_);
+  LastCmdListEvent->Msg = "CmdListFinishTracker";
+  LastCmdListEvent->setSubmitQueue(this);
   {
     LOCK( // CHIPBackendLevel0::EventCommandListMap
         ((CHIPBackendLevel0 *)Backend)->CommandListsMtx);
 
-    // Associate this event with the command list. Once the events are signaled,
-    // CHIPEventMonitorLevel0 will destroy the command list
-
-    logTrace("assoc event {} w/ cmdlist", (void *)LastCmdListEvent);
-    ((CHIPBackendLevel0 *)Backend)
-        ->EventCommandListMap[(CHIPEventLevel0 *)LastCmdListEvent] =
-        CommandList;
     // The application must not call this function from
     // simultaneous threads with the same command list handle.
     // Done via GET_COMMAND_LIST
     Status = zeCommandListAppendBarrier(CommandList, LastCmdListEvent->peek(),
                                         0, nullptr);
     CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    for (auto *Dependency : CmdListDependencies_)
+      LastCmdListEvent->addDependency(Dependency);
+    CmdListDependencies_.clear();
+
+    // Associate this event with the command list. Once the event is
+    // signaled, CHIPStaleEventMonitorLevel0 gives the command list back to
+    // the pool.
+
+    logTrace("assoc event {} w/ cmdlist", (void *)LastCmdListEvent);
+    ((CHIPBackendLevel0 *)Backend)->EventCommandListMap[LastCmdListEvent] = {
+        CommandList, CmdListPool_, Placement_};
     // The application must not call this function from
     // simultaneous threads with the same command list handle.
     // Done via GET_COMMAND_LIST
     Status = zeCommandListClose(CommandList);
     CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    Placement_->submitted();
 #ifdef DUBIOUS_LOCKS
-    LOCK(Backend->DubiousLockLevel0)
+    LOCK(ZeCmdQMtx_); // CHIPQueueLevel0::ZeCmdQ_
 #endif
     Status =
         zeCommandQueueExecuteCommandLists(ZeCmdQ_, 1, &CommandList, nullptr);
     CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
   }
 
+  // Tracking wakes the stale event monitor which takes CommandListsMtx.
   LastCmdListEvent->track();
-#endif
 };
 
 // End CHIPQueueLevelZero
@@ -1386,9 +2171,9 @@ void CHIPQueueLevel0::executeCommandList(ze_command_list_handle_t CommandList) {
 LZEventPool::LZEventPool(CHIPContextLevel0 *Ctx, unsigned int Size)
     : Ctx_(Ctx), Size_(Size) {
 
+  // The pooled events are internal and never timed. Timing events are
+  // created with an event pool of their own.
   unsigned int PoolFlags = ZE_EVENT_POOL_FLAG_HOST_VISIBLE;
-  // if (!flags.isDisableTiming())
-  //   pool_flags = pool_flags | ZE_EVENT_POOL_FLAG_KERNEL_TIMESTAMP;
 
   ze_event_pool_desc_t EventPoolDesc = {
       ZE_STRUCTURE_TYPE_EVENT_POOL_DESC, // stype
@@ -1403,9 +2188,8 @@ LZEventPool::LZEventPool(CHIPContextLevel0 *Ctx, unsigned int Size)
                               "Level Zero Event_ pool creation fail! ");
 
   for (unsigned i = 0; i < Size_; i++) {
-    CHIPEventFlags Flags;
+    CHIPEventFlags Flags(hipEventDisableTiming);
     Events_.push_back(new CHIPEventLevel0(Ctx_, this, i, Flags));
-    FreeSlots_.push(i);
   }
 };
 
@@ -1421,34 +2205,241 @@ LZEventPool::~LZEventPool() {
   assert(Status == ZE_RESULT_SUCCESS);
 };
 
-CHIPEventLevel0 *LZEventPool::getEvent() {
-  int PoolIndex = getFreeSlot();
-  if (PoolIndex == -1)
-    return nullptr;
-  auto Event = Events_[PoolIndex];
-  Event->reset();
+// End EventPool
+
+// EventAllocator
+// ***********************************************************************
+
+/// Threads are assigned to the shards round-robin.
+static size_t getThreadShard() {
+  static std::atomic<size_t> NextShard{0};
+  thread_local size_t Shard = NextShard++;
+  return Shard;
+}
 
+// LZCommandListPool
+// ***********************************************************************
+LZCommandListPool::~LZCommandListPool() {
+  logDebug("Command lists: {} created, {} reused, {} destroyed",
+           NumCreated_.load(), NumReused_.load(), NumDestroyed_.load());
+  for (auto CommandList : FreeLists_) {
+    auto Status = zeCommandListDestroy(CommandList);
+    if (Status != ZE_RESULT_SUCCESS)
+      logError("zeCommandListDestroy failed: {}", resultToString(Status));
+  }
+}
+
+ze_command_list_handle_t LZCommandListPool::acquire() {
+  {
+    LOCK(Mtx_); // LZCommandListPool::FreeLists_
+    if (!FreeLists_.empty()) {
+      auto CommandList = FreeLists_.back();
+      FreeLists_.pop_back();
+      NumReused_++;
+      return CommandList;
+    }
+  }
+
+  ze_command_list_handle_t CommandList;
+  auto Status = zeCommandListCreate(ZeCtx_, ZeDev_, &Desc_, &CommandList);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS,
+                              hipErrorInitializationError);
+  NumCreated_++;
+  return CommandList;
+}
+
+void LZCommandListPool::release(ze_command_list_handle_t CommandList) {
+  bool Keep;
+  {
+    LOCK(Mtx_); // LZCommandListPool::FreeLists_
+    Keep = FreeLists_.size() < MaxSize_;
+  }
+  if (Keep) {
+    // The application must not call this function from simultaneous
+    // threads with the same command list handle.
+    // Done. The list is owned by the caller until it is in FreeLists_.
+    auto Status = zeCommandListReset(CommandList);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+    LOCK(Mtx_); // LZCommandListPool::FreeLists_
+    FreeLists_.push_back(CommandList);
+    return;
+  }
+
+  // The application must not call this function from simultaneous
+  // threads with the same command list handle.
+  // Done. The list is owned by the caller.
+  auto Status = zeCommandListDestroy(CommandList);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+  NumDestroyed_++;
+}
+
+// LZQueueGroupLoad
+// ***********************************************************************
+void LZQueueGroupLoad::init(size_t NumIndices) {
+  NumIndices_ = NumIndices;
+  NumStreams_.reset(new std::atomic<size_t>[NumIndices]);
+  NumInFlight_.reset(new std::atomic<size_t>[NumIndices]);
+  for (size_t I = 0; I < NumIndices; I++) {
+    NumStreams_[I] = 0;
+    NumInFlight_[I] = 0;
+  }
+}
+
+bool LZQueueGroupLoad::isLessLoaded(size_t A, size_t B) const {
+  if (NumInFlight_[A] != NumInFlight_[B])
+    return NumInFlight_[A] < NumInFlight_[B];
+  return NumStreams_[A] < NumStreams_[B];
+}
+
+uint32_t LZQueueGroupLoad::acquire(int Affinity) {
+  assert(NumIndices_ > 0);
+  size_t Index;
+  if (Affinity >= 0) {
+    Index = size_t(Affinity) % NumIndices_;
+  } else {
+    size_t Start = NextIndex_++ % NumIndices_;
+    Index = Start;
+    for (size_t I = 1; I < NumIndices_; I++) {
+      size_t Candidate = (Start + I) % NumIndices_;
+      if (isLessLoaded(Candidate, Index))
+        Index = Candidate;
+    }
+  }
+  NumStreams_[Index]++;
+  return Index;
+}
+
+uint32_t LZQueueGroupLoad::rebalance(uint32_t Index) {
+  size_t Best = Index;
+  for (size_t I = 0; I < NumIndices_; I++)
+    if (NumInFlight_[I] < NumInFlight_[Best])
+      Best = I;
+  if (NumInFlight_[Best] + RebalanceMargin > NumInFlight_[Index])
+    return Index;
+  NumStreams_[Index]--;
+  NumStreams_[Best]++;
+  return Best;
+}
+
+LZEventAllocator::~LZEventAllocator() {
+  logDebug("Event pools: {} created, {} trimmed, {} events in use at peak",
+           NumPoolsCreated_.load(), NumPoolsTrimmed_.load(),
+           PeakInUse_.load());
+  // The pools are not destroyed as queues, which are destroyed after the
+  // context, may still reference their events.
+}
+
+CHIPEventLevel0 *LZEventAllocator::takeFrom(Shard &S) {
+  LOCK(S.Mtx); // LZEventAllocator::Shard::FreeEvents
+  if (S.FreeEvents.empty())
+    return nullptr;
+  auto *Event = S.FreeEvents.back();
+  S.FreeEvents.pop_back();
+  NumFree_--;
+  Event->EventPool->NumInUse++;
   return Event;
-};
+}
 
-int LZEventPool::getFreeSlot() {
-  LOCK(EventPoolMtx); // LZEventPool::FreeSlots_
-  if (FreeSlots_.size() == 0)
-    return -1;
+CHIPEventLevel0 *LZEventAllocator::grow() {
+  LOCK(PoolsMtx_); // LZEventAllocator::Pools_
+  if (NumFree_.load())
+    return nullptr;
 
-  auto Slot = FreeSlots_.top();
-  FreeSlots_.pop();
+  logTrace("No free events in {} event pools ({} events in use). Creating a "
+           "new event pool",
+           Pools_.size(), NumInUse_.load());
+  auto *Pool = new LZEventPool(Ctx_, EVENT_POOL_SIZE);
+  Pools_.push_back(Pool);
+  NumPoolsCreated_++;
+
+  // Keep the first event for the caller and spread the rest over the shards.
+  auto &Events = Pool->getEvents();
+  Pool->NumInUse = 1;
+  for (size_t ShardIdx = 0; ShardIdx < NumShards; ShardIdx++) {
+    auto &S = Shards_[ShardIdx];
+    LOCK(S.Mtx); // LZEventAllocator::Shard::FreeEvents
+    for (size_t i = ShardIdx + 1; i < Events.size(); i += NumShards) {
+      NumFree_++;
+      S.FreeEvents.push_back(Events[i]);
+    }
+  }
+  return Events[0];
+}
 
-  return Slot;
+void LZEventAllocator::trim() {
+  LOCK(PoolsMtx_); // LZEventAllocator::Pools_
+  // Prefer the newest pool. The events of the oldest ones are the most
+  // likely to be in use.
+  auto It = std::find_if(Pools_.rbegin(), Pools_.rend(),
+                         [](LZEventPool *P) { return P->NumInUse == 0; });
+  if (It == Pools_.rend())
+    return;
+  LZEventPool *Pool = *It;
+  // Keep a pool's worth of spare events.
+  if (NumFree_.load() < Pool->getSize() + EVENT_POOL_SIZE)
+    return;
+
+  {
+    // No event can change hands while all the shards are locked.
+    std::unique_lock<std::mutex> Locks[NumShards];
+    for (size_t i = 0; i < NumShards; i++)
+      Locks[i] = std::unique_lock<std::mutex>(Shards_[i].Mtx);
+    if (Pool->NumInUse != 0)
+      return;
+
+    for (auto &S : Shards_)
+      S.FreeEvents.erase(std::remove_if(S.FreeEvents.begin(),
+                                        S.FreeEvents.end(),
+                                        [=](CHIPEventLevel0 *E) {
+                                          return E->EventPool == Pool;
+                                        }),
+                         S.FreeEvents.end());
+    NumFree_ -= Pool->getSize();
+  }
+
+  Pools_.erase(std::next(It).base());
+  NumPoolsTrimmed_++;
+  logTrace("Destroying an unused event pool. {} event pools remain",
+           Pools_.size());
+  delete Pool;
 }
 
-void LZEventPool::returnSlot(int Slot) {
-  LOCK(EventPoolMtx); // LZEventPool::FreeSlots_
-  FreeSlots_.push(Slot);
-  return;
+CHIPEventLevel0 *LZEventAllocator::acquire() {
+  CHIPEventLevel0 *Event = nullptr;
+  size_t Home = getThreadShard();
+  while (!Event) {
+    for (size_t i = 0; i < NumShards && !Event && NumFree_.load(); i++)
+      Event = takeFrom(Shards_[(Home + i) % NumShards]);
+    if (!Event)
+      Event = grow();
+  }
+
+  size_t InUse = ++NumInUse_;
+  size_t Peak = PeakInUse_.load();
+  while (InUse > Peak && !PeakInUse_.compare_exchange_weak(Peak, InUse))
+    ;
+
+  Event->reset();
+  return Event;
 }
 
-// End EventPool
+void LZEventAllocator::release(CHIPEventLevel0 *Event) {
+  assert(Event->EventPool && "Not a pooled event");
+  auto &S = Shards_[Event->EventPoolIndex % NumShards];
+  {
+    LOCK(S.Mtx); // LZEventAllocator::Shard::FreeEvents
+    NumFree_++;
+    S.FreeEvents.push_back(Event);
+    Event->EventPool->NumInUse--;
+  }
+  size_t InUse = --NumInUse_;
+
+  // Trim when the demand has dropped well below the capacity.
+  if (InUse % EVENT_POOL_SIZE == 0 && NumFree_.load() >= 2 * EVENT_POOL_SIZE)
+    trim();
+}
+
+// End EventAllocator
 
 // CHIPBackendLevel0
 // ***********************************************************************
@@ -1493,6 +2484,7 @@ void CHIPBackendLevel0::uninitialize() {
     LOCK(CallbackEventMonitor_->EventMonitorMtx); // CHIPEventMonitor::Stop
     CallbackEventMonitor_->Stop = true;
   }
+  ((CHIPCallbackEventMonitorLevel0 *)CallbackEventMonitor_)->wakeUp();
   CallbackEventMonitor_->join();
 
   {
@@ -1500,17 +2492,12 @@ void CHIPBackendLevel0::uninitialize() {
     LOCK(StaleEventMonitor_->EventMonitorMtx); // CHIPEventMonitor::Stop
     StaleEventMonitor_->Stop = true;
   }
+  ((CHIPStaleEventMonitorLevel0 *)StaleEventMonitor_)->wakeUp();
   StaleEventMonitor_->join();
 
-  if (Backend->Events.size()) {
-    logTrace("Remaining {} events that haven't been collected:",
-             Backend->Events.size());
-    for (auto *E : Backend->Events)
-      logTrace("{} status= {} refc={}", E->Msg, E->getEventStatusStr(),
-               E->getCHIPRefc());
+  if (((CHIPBackendLevel0 *)Backend)->EventCommandListMap.size())
     logTrace("Remaining {} command lists that haven't been collected:",
              ((CHIPBackendLevel0 *)Backend)->EventCommandListMap.size());
-  }
   return;
 }
 
@@ -1524,6 +2511,26 @@ void CHIPBackendLevel0::initializeImpl(std::string CHIPPlatformStr,
                                        std::string CHIPDeviceStr) {
   logTrace("CHIPBackendLevel0 Initialize");
   MinQueuePriority_ = ZE_COMMAND_QUEUE_PRIORITY_PRIORITY_HIGH;
+
+  if (const char *BatchSize = std::getenv("CHIP_L0_BATCH_SIZE"))
+    MaxBatchSize = std::max(1, std::atoi(BatchSize));
+  if (const char *BatchLatency = std::getenv("CHIP_L0_BATCH_LATENCY_US"))
+    MaxBatchLatency = std::chrono::microseconds(std::atoi(BatchLatency));
+  if (const char *PoolSize = std::getenv("CHIP_L0_CMD_LIST_POOL_SIZE"))
+    MaxCommandListPoolSize = std::max(0, std::atoi(PoolSize));
+  if (const char *ChunkSize = std::getenv("CHIP_L0_COPY_CHUNK_SIZE"))
+    CopyChunkSize = std::strtoull(ChunkSize, nullptr, 10);
+  if (const char *CopyEngines = std::getenv("CHIP_L0_COPY_ENGINES"))
+    MaxCopyEngines = std::max(0, std::atoi(CopyEngines));
+#ifdef L0_IMM_QUEUES
+  if (MaxBatchSize > 1)
+    logWarn("CHIP_L0_BATCH_SIZE is ignored with immediate command lists");
+#endif
+  logDebug("CHIP_L0_BATCH_SIZE={} CHIP_L0_BATCH_LATENCY_US={} "
+           "CHIP_L0_CMD_LIST_POOL_SIZE={} CHIP_L0_COPY_CHUNK_SIZE={} "
+           "CHIP_L0_COPY_ENGINES={}",
+           MaxBatchSize, MaxBatchLatency.count(), MaxCommandListPoolSize,
+           CopyChunkSize, MaxCopyEngines);
   ze_result_t Status;
   Status = zeInit(0);
   if (Status != ZE_RESULT_SUCCESS) {
@@ -1752,6 +2759,37 @@ CHIPDeviceLevel0 *CHIPDeviceLevel0::create(ze_device_handle_t ZeDev,
 
 void CHIPDeviceLevel0::resetImpl() { UNIMPLEMENTED(); }
 
+void CHIPDeviceLevel0::waitForEvents(const std::vector<CHIPEvent *> &Events) {
+  std::vector<CHIPEventLevel0 *> Pending;
+  for (auto *Event : Events) {
+    auto *EventLz = (CHIPEventLevel0 *)Event;
+    EventLz->flushBatch();
+    Pending.push_back(EventLz);
+  }
+
+  // Poll all the events together. Blocking on them one after the other
+  // takes as long as the slowest one.
+  synchronize(
+      [&]() {
+        Pending.erase(std::remove_if(Pending.begin(), Pending.end(),
+                                     [](CHIPEventLevel0 *E) {
+                                       return zeEventQueryStatus(E->peek()) ==
+                                              ZE_RESULT_SUCCESS;
+                                     }),
+                      Pending.end());
+        return Pending.empty();
+      },
+      [&]() {
+        for (auto *E : Pending) {
+          ze_result_t Status = zeEventHostSynchronize(E->peek(), UINT64_MAX);
+          CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
+        }
+      });
+
+  for (auto *Event : Events)
+    Event->updateFinishStatus(false);
+}
+
 void CHIPDeviceLevel0::populateDevicePropertiesImpl() {
   ze_result_t Status = ZE_RESULT_SUCCESS;
 
@@ -2221,24 +3259,28 @@ void CHIPModuleLevel0::compile(CHIPDevice *ChipDev) {
 }
 
 void CHIPExecItemLevel0::setupAllArgs() {
-  LOCK(this->ExecItemMtx); // required by zeKernelSetArgumentValue
-  if (!ArgsSetup) {
-    ArgsSetup = true;
-  } else {
-    return;
-  }
   CHIPKernelLevel0 *Kernel = (CHIPKernelLevel0 *)ChipKernel_;
+  auto &KernelHandle = Kernel->getHandle(ChipQueue_);
 
   SPVFuncInfo *FuncInfo = ChipKernel_->getFuncInfo();
 
-  if (FuncInfo->hasByRefArgs()) {
-    ArgSpillBuffer_ =
-        std::make_shared<CHIPArgSpillBuffer>(ChipQueue_->getContext());
-    ArgSpillBuffer_->computeAndReserveSpace(*FuncInfo);
-  }
+  // The spill ring is in host USM which the device reads directly, so the
+  // pooled spill buffers need no upload.
+  if (FuncInfo->hasByRefArgs())
+    ChipQueue_->reserveArgSpillBuffer(ArgSpillBuffer_, *Kernel,
+                                      hipMemoryTypeHost);
+
+  assert(Args_.size() == FuncInfo->getNumClientArgs());
+  for (const SPVArgPlanEntry &Arg : Kernel->getArgPlan()) {
+    const void *ArgData =
+        Arg.isWorkgroupPtr() ? nullptr : Args_[Arg.ClientIndex];
+    // The value and its size to be passed to zeKernelSetArgumentValue().
+    const void *ArgValue = ArgData;
+    size_t ArgSize = Arg.Size;
+    ze_image_handle_t ImageHandle;
+    ze_sampler_handle_t SamplerHandle;
+    void *SpillSlot;
 
-  auto ArgVisitor = [&](const SPVFuncInfo::KernelArg &Arg) -> void {
-    ze_result_t Status;
     switch (Arg.Kind) {
     default:
       CHIPERR_LOG_AND_THROW("Internal CHIP-SPV error: Unknown argument kind.",
@@ -2246,66 +3288,67 @@ void CHIPExecItemLevel0::setupAllArgs() {
 
     case SPVTypeKind::Image: {
       auto *TexObj =
-          *reinterpret_cast<const CHIPTextureLevel0 *const *>(Arg.Data);
-      ze_image_handle_t ImageHandle = TexObj->getImage();
-      logTrace("setImageArg {} size {}\n", Arg.Index,
-               sizeof(ze_image_handle_t));
-      Status = zeKernelSetArgumentValue(
-          Kernel->get(), Arg.Index, sizeof(ze_image_handle_t), &ImageHandle);
+          *reinterpret_cast<const CHIPTextureLevel0 *const *>(ArgData);
+      ImageHandle = TexObj->getImage();
+      ArgValue = &ImageHandle;
+      ArgSize = sizeof(ze_image_handle_t);
+      logTrace("setImageArg {} size {}\n", Arg.Index, ArgSize);
       break;
     }
     case SPVTypeKind::Sampler: {
       auto *TexObj =
-          *reinterpret_cast<const CHIPTextureLevel0 *const *>(Arg.Data);
-      ze_sampler_handle_t SamplerHandle = TexObj->getSampler();
-      logTrace("setSamplerArg {} size {}\n", Arg.Index,
-               sizeof(ze_sampler_handle_t));
-      Status =
-          zeKernelSetArgumentValue(Kernel->get(), Arg.Index,
-                                   sizeof(ze_sampler_handle_t), &SamplerHandle);
+          *reinterpret_cast<const CHIPTextureLevel0 *const *>(ArgData);
+      SamplerHandle = TexObj->getSampler();
+      ArgValue = &SamplerHandle;
+      ArgSize = sizeof(ze_sampler_handle_t);
+      logTrace("setSamplerArg {} size {}\n", Arg.Index, ArgSize);
       break;
     }
     case SPVTypeKind::POD:
     case SPVTypeKind::Pointer: {
-      const auto *ArgData = Arg.Data;
-      auto ArgSize = Arg.Size;
-
       if (Arg.Kind == SPVTypeKind::Pointer) {
         if (Arg.isWorkgroupPtr()) {
           // Undocumented way to allocate Workgroup memory (which is
           // similar to OpenCL's way to allocate __local memory).
-          ArgData = nullptr;
+          ArgValue = nullptr;
           ArgSize = SharedMem_;
-        } else if (*(const void **)Arg.Data == nullptr) {
+        } else if (*(const void **)ArgData == nullptr) {
           // zeKernelSetArgumentValue does not accept nullptrs as
           // pointer argument values.  Work-around this by allocating a small
           // piece of Workgroup memory (via nullptr magic).
-          ArgData = nullptr;
+          ArgValue = nullptr;
           ArgSize = 0;
         }
       }
 
-      logTrace("setArg {} size {} addr {}\n", Arg.Index, ArgSize, ArgData);
-      Status =
-          zeKernelSetArgumentValue(Kernel->get(), Arg.Index, ArgSize, ArgData);
+      logTrace("setArg {} size {} addr {}\n", Arg.Index, ArgSize, ArgValue);
       break;
     }
     case SPVTypeKind::PODByRef: {
-      auto *SpillSlot = ArgSpillBuffer_->allocate(Arg);
+      SpillSlot = ArgSpillBuffer_.allocate(Arg, ArgData);
       assert(SpillSlot);
-      Status = zeKernelSetArgumentValue(Kernel->get(), Arg.Index,
-                                        sizeof(void *), &SpillSlot);
+      ArgValue = &SpillSlot;
+      ArgSize = sizeof(void *);
       break;
     }
     }
+
+    // Relaunches commonly bind the same values.
+    if (Kernel->isArgBound(KernelHandle.ArgShadow, Arg.Index, ArgSize,
+                           ArgValue))
+      continue;
+
+    ze_result_t Status = zeKernelSetArgumentValue(
+        KernelHandle.ZeKernel, Arg.Index, ArgSize, ArgValue);
     CHIPERR_CHECK_LOG_AND_THROW(Status, ZE_RESULT_SUCCESS, hipErrorTbd);
-  };
-  FuncInfo->visitKernelArgs(getArgs(), ArgVisitor);
+    Kernel->recordArgBinding(KernelHandle.ArgShadow, Arg.Index, ArgSize,
+                             ArgValue);
+  }
 
-  if (FuncInfo->hasByRefArgs())
-    ChipQueue_->memCopyAsync(ArgSpillBuffer_->getDeviceBuffer(),
-                             ArgSpillBuffer_->getHostBuffer(),
-                             ArgSpillBuffer_->getSize());
+  if (FuncInfo->hasByRefArgs() && ArgSpillBuffer_.needsUpload())
+    ChipQueue_->memCopyAsync(ArgSpillBuffer_.getDeviceBuffer(),
+                             ArgSpillBuffer_.getHostBuffer(),
+                             ArgSpillBuffer_.getSize());
 
   return;
 }
@@ -31,6 +31,8 @@
 #include "../include/ze_api.h"
 #include "../src/common.hh"
 
+#include <chrono>
+
 std::string resultToString(ze_result_t Status);
 
 // fw declares
@@ -51,7 +53,6 @@ public:
       : CHIPExecItemLevel0(Other.GridDim_, Other.BlockDim_, Other.SharedMem_,
                            Other.ChipQueue_) {
     ChipKernel_ = Other.ChipKernel_;
-    this->ArgsSetup = Other.ArgsSetup;
     this->Args_ = Other.Args_;
   }
 
@@ -69,22 +70,39 @@ public:
 };
 
 class CHIPEventLevel0 : public CHIPEvent {
-public:
-  using ActionFn = std::function<void()>;
-
 private:
-  // Used for resolving device counter overflow
-  uint64_t HostTimestamp_ = 0, DeviceTimestamp_ = 0;
+  // Host time of the recording. Orders the events for getElapsedTime().
+  uint64_t HostTimestamp_ = 0;
   friend class CHIPEventLevel0;
   // The handler of event_pool and event
   ze_event_handle_t Event_;
   ze_event_pool_handle_t EventPoolHandle_;
 
-  // The timestamp value
-  uint64_t Timestamp_;
-
   std::vector<ActionFn> Actions_;
 
+  /// Timing events only. A recording signals TimestampEvent_ and copies its
+  /// kernel timestamp to TimestampResult_, in host memory, before Event_ is
+  /// signaled.
+  ze_event_pool_handle_t TimestampPool_ = nullptr;
+  ze_event_handle_t TimestampEvent_ = nullptr;
+  ze_kernel_timestamp_result_t *TimestampResult_ = nullptr;
+  void createTimestampEvent();
+
+  /// The queue holding the command which signals this event in a batch not
+  /// submitted yet. Null otherwise.
+  std::atomic<CHIPQueueLevel0 *> BatchQueue_{nullptr};
+
+  /// The queue the command signaling this event was submitted to, if known.
+  /// Groups the events for retirement and is never dereferenced.
+  std::atomic<const CHIPQueueLevel0 *> SubmitQueue_{nullptr};
+
+  /// Set once the stale event monitor is done with the event. A retired
+  /// pooled event goes back to the pool with its last reference.
+  std::atomic<bool> Retired_{false};
+
+protected:
+  virtual void released() override;
+
 public:
   uint32_t getValidTimestampBits();
   uint64_t getHostTimestamp() { return HostTimestamp_; }
@@ -101,11 +119,29 @@ public:
 
   void recordStream(CHIPQueue *ChipQueue) override;
 
+  /**
+   * @brief Append the commands which signal the event once the preceding
+   * commands of the list are complete.
+   *
+   * @return true if the last command appended is a barrier
+   */
+  bool appendSignal(ze_command_list_handle_t CommandList);
+
   virtual bool wait() override;
 
+  /**
+   * @brief Block until the event is signaled or the timeout expires. Unlike
+   * wait(), a pending batch is not submitted.
+   *
+   * @return true if the event was signaled
+   */
+  bool waitFor(uint64_t TimeoutNs);
+
   virtual bool updateFinishStatus(bool ThrowErrorIfNotReady = true) override;
 
-  unsigned long getFinishTime();
+  /// Return the device time, in timer ticks, the event was signaled at.
+  /// Only events created with timing enabled have one.
+  uint64_t getFinishTime();
 
   virtual float getElapsedTime(CHIPEvent *Other) override;
 
@@ -114,11 +150,14 @@ public:
   void reset();
 
   ze_event_handle_t peek();
-  ze_event_handle_t get(std::string Msg);
+  /// Get the native event and take a reference to this event.
+  ze_event_handle_t get(const char *Reason);
 
-  /// Bind an action which is promised to be executed when the event is
-  /// finished.
-  void addAction(ActionFn Action) { Actions_.emplace_back(Action); }
+  /// The actions are executed by the stale event monitor when it retires
+  /// the event.
+  void addAction(ActionFn Action) override {
+    Actions_.emplace_back(std::move(Action));
+  }
 
   /// Execute the actions. The event must be finished.
   void doActions() {
@@ -127,6 +166,27 @@ public:
       Action();
     Actions_.clear();
   }
+
+  /// Set or clear the queue holding the unsubmitted batch which signals
+  /// this event. Used by CHIPQueueLevel0.
+  void setBatchQueue(CHIPQueueLevel0 *Queue) { BatchQueue_ = Queue; }
+
+  /// Return true if the command signaling this event has not been
+  /// submitted yet. Such an event can't become ready.
+  bool isBatchPending() const { return BatchQueue_ != nullptr; }
+  bool isBatchPendingOn(const CHIPQueueLevel0 *Queue) const {
+    return BatchQueue_ == Queue;
+  }
+
+  /// Submit the batch holding the command which signals this event.
+  void flushBatch();
+
+  /// Called by CHIPStaleEventMonitorLevel0 once the event has finished,
+  /// before it drops its reference.
+  void markRetired() { Retired_ = true; }
+
+  void setSubmitQueue(const CHIPQueueLevel0 *Queue) { SubmitQueue_ = Queue; }
+  const CHIPQueueLevel0 *getSubmitQueue() const { return SubmitQueue_; }
 };
 
 class CHIPCallbackDataLevel0 : public CHIPCallbackData {
@@ -145,43 +205,281 @@ public:
   }
 };
 
+/**
+ * @brief Runs stream callbacks.
+ *
+ * The monitor thread hands the callbacks over to a waiter thread per
+ * stream. A waiter blocks on the event which signals that the work
+ * preceding its oldest callback has finished and then runs the callback
+ * right away, so a callback behind unfinished work does not hold up the
+ * callbacks of other streams.
+ */
 class CHIPCallbackEventMonitorLevel0 : public CHIPEventMonitor {
+  /// Runs the callbacks of one stream in order.
+  struct StreamWaiter {
+    std::mutex Mtx;
+    std::condition_variable Cond;
+    /// Callbacks handed over by the monitor thread. Guarded by Mtx.
+    std::deque<CHIPCallbackDataLevel0 *> Incoming;
+    /// Set when the stream is destroyed or the monitor stops. Guarded by
+    /// Mtx.
+    bool Closed = false;
+    std::thread Thread;
+  };
+
+  std::map<const CHIPQueue *, std::unique_ptr<StreamWaiter>> Waiters_;
+  std::mutex WaitersMtx_;
+
+  /// Hand the callbacks in CHIPBackend::CallbackQueue over to the waiters.
+  /// Called with CHIPBackend::CallbackQueueMtx held.
+  void dispatchCallbacks();
+  void runWaiter(StreamWaiter &Waiter);
+  void closeWaiter(StreamWaiter &Waiter);
+
 public:
   ~CHIPCallbackEventMonitorLevel0() {
     logTrace("CHIPCallbackEventMonitorLevel0 DEST");
     join();
   };
   virtual void monitor() override;
+  /// Wake up the monitor so it notices Stop.
+  void wakeUp();
+
+  /// Stop the waiter of a stream being destroyed. The stream must have
+  /// finished.
+  void forgetQueue(const CHIPQueue *Queue);
 };
 
+/**
+ * @brief Reclaims tracked events and the command lists associated with them.
+ *
+ * The monitor thread hands the tracked events to a waiter thread per
+ * submitting queue. A waiter blocks on the oldest unfinished event of its
+ * queue and retires the events in the order they were tracked, so a slow
+ * queue does not hold up the events of the others. A retired event goes
+ * back to its pool when its last reference is dropped.
+ */
 class CHIPStaleEventMonitorLevel0 : public CHIPEventMonitor {
+  /// Retires the events of one queue.
+  struct QueueWaiter {
+    std::mutex Mtx;
+    std::condition_variable Cond;
+    /// Events handed over by the monitor thread. Guarded by Mtx.
+    std::vector<CHIPEventLevel0 *> Incoming;
+    /// Set when the queue is destroyed or the monitor stops. Guarded by Mtx.
+    bool Closed = false;
+    std::thread Thread;
+  };
+
+  /// The waiters keyed by the submitting queue. The events of an unknown
+  /// queue go to the waiter under null and may finish in any order.
+  std::map<const CHIPQueueLevel0 *, std::unique_ptr<QueueWaiter>> Waiters_;
+  std::mutex WaitersMtx_;
+  /// The number of waiters waiting for the batch holding their oldest
+  /// event to be submitted.
+  std::atomic<unsigned> NumWaitingForBatch_{0};
+
+  /// Hand the events in CHIPBackend::Events over to the waiters. Called
+  /// with CHIPBackend::EventsMtx held.
+  void dispatchTrackedEvents();
+  void runWaiter(QueueWaiter &Waiter, bool InOrder);
+  /// Retire the finished events. With InOrder, only a run from the oldest.
+  void retireFinishedEvents(std::deque<CHIPEventLevel0 *> &Events,
+                            bool InOrder);
+  /// Recycle the command lists whose completion the retired events track.
+  void recycleCommandLists(const std::vector<CHIPEventLevel0 *> &Retired);
+  void closeWaiter(QueueWaiter &Waiter);
+
 public:
   ~CHIPStaleEventMonitorLevel0() {
     logTrace("CHIPStaleEventMonitorLevel0 DEST");
     join();
   };
   virtual void monitor() override;
+  /// Wake up the monitor so it notices Stop.
+  void wakeUp();
+
+  /// Wake up the waiter of the queue if it waits for the batch just
+  /// submitted. Cheap while no waiter does.
+  void batchSubmitted(const CHIPQueueLevel0 *Queue) {
+    if (NumWaitingForBatch_.load())
+      wakeWaiter(Queue);
+  }
+  void wakeWaiter(const CHIPQueueLevel0 *Queue);
+
+  /// Retire the remaining events of a queue being destroyed and stop its
+  /// waiter. The queue must have finished.
+  void forgetQueue(const CHIPQueueLevel0 *Queue);
 };
 
+/// A Level Zero event pool and the events created from it.
 class LZEventPool {
 private:
   CHIPContextLevel0 *Ctx_;
   ze_event_pool_handle_t EventPool_;
   unsigned int Size_;
-  std::stack<int> FreeSlots_;
   std::vector<CHIPEventLevel0 *> Events_;
 
-  int getFreeSlot();
-
 public:
   std::mutex EventPoolMtx;
+  /// The number of events of this pool handed out. Only changed while
+  /// holding a shard lock of LZEventAllocator.
+  std::atomic<unsigned> NumInUse{0};
+
   LZEventPool(CHIPContextLevel0 *Ctx, unsigned int Size);
   ~LZEventPool();
   ze_event_pool_handle_t get() { return EventPool_; }
+  unsigned getSize() const { return Size_; }
+  const std::vector<CHIPEventLevel0 *> &getEvents() const { return Events_; }
+};
+
+/**
+ * @brief Hands out the events of a context's event pools.
+ *
+ * The free events are spread over a few shards, each with its own lock. A
+ * thread allocates from the shard it hashes to and steals from the other
+ * shards when it is empty, so acquisition takes O(1) time regardless of the
+ * number of pools. A new pool is created when all shards are empty and
+ * fully free pools are destroyed when more than a pool's worth of events
+ * stays unused.
+ */
+class LZEventAllocator {
+  static constexpr size_t NumShards = 8;
+  struct alignas(64) Shard {
+    std::mutex Mtx;
+    std::vector<CHIPEventLevel0 *> FreeEvents;
+  };
+
+  CHIPContextLevel0 *Ctx_;
+  Shard Shards_[NumShards];
+  std::atomic<size_t> NumFree_{0};
+
+  std::mutex PoolsMtx_;
+  std::vector<LZEventPool *> Pools_; // Guarded by PoolsMtx_.
+
+  // Statistics.
+  std::atomic<size_t> NumInUse_{0};
+  std::atomic<size_t> PeakInUse_{0};
+  std::atomic<size_t> NumPoolsCreated_{0};
+  std::atomic<size_t> NumPoolsTrimmed_{0};
+
+  CHIPEventLevel0 *takeFrom(Shard &S);
+  /// Create a pool and return one of its events. Returns null if another
+  /// thread made events available in the meantime.
+  CHIPEventLevel0 *grow();
+  /// Destroy a pool whose events are all free if there are enough spare
+  /// events without it.
+  void trim();
+
+public:
+  LZEventAllocator(CHIPContextLevel0 *Ctx) : Ctx_(Ctx) {}
+  ~LZEventAllocator();
+
+  /// Take a free event and reset it.
+  CHIPEventLevel0 *acquire();
+  /// Give an event back. Must not be used after this.
+  void release(CHIPEventLevel0 *Event);
+};
+
+/**
+ * @brief Recycles the regular command lists of a queue.
+ *
+ * A submitted command list is given back by the stale event monitor once
+ * the barrier ending it has signaled, i.e. after every command in the list
+ * has completed. It is then reset and kept for reuse, unless the pool
+ * already holds MaxSize lists. The pool is shared by its queue and the
+ * command lists in flight so that lists which finish after their queue has
+ * been destroyed can still be given back.
+ */
+class LZCommandListPool {
+  ze_context_handle_t ZeCtx_;
+  ze_device_handle_t ZeDev_;
+  ze_command_list_desc_t Desc_;
+  size_t MaxSize_;
+
+  std::mutex Mtx_;
+  std::vector<ze_command_list_handle_t> FreeLists_; // Guarded by Mtx_.
+
+  // Statistics.
+  std::atomic<size_t> NumCreated_{0};
+  std::atomic<size_t> NumReused_{0};
+  std::atomic<size_t> NumDestroyed_{0};
+
+public:
+  LZCommandListPool(ze_context_handle_t ZeCtx, ze_device_handle_t ZeDev,
+                    const ze_command_list_desc_t &Desc, size_t MaxSize)
+      : ZeCtx_(ZeCtx), ZeDev_(ZeDev), Desc_(Desc), MaxSize_(MaxSize) {}
+  ~LZCommandListPool();
+
+  /// Return an open, empty command list, creating one if none is free.
+  ze_command_list_handle_t acquire();
+  /// Give back a command list whose commands have completed.
+  void release(ze_command_list_handle_t CommandList);
+
+  size_t getNumCreated() const { return NumCreated_; }
+  size_t getNumReused() const { return NumReused_; }
+  size_t getNumDestroyed() const { return NumDestroyed_; }
+};
 
-  void returnSlot(int Slot);
+/**
+ * The load of the hardware queues of a command queue group: the streams
+ * placed on each queue index and their command lists in flight. The
+ * counters are updated without a lock so the placement is approximate.
+ */
+class LZQueueGroupLoad {
+  size_t NumIndices_ = 0;
+  std::unique_ptr<std::atomic<size_t>[]> NumStreams_;
+  std::unique_ptr<std::atomic<size_t>[]> NumInFlight_;
+  /// Where the search for the least loaded index starts. Advanced on each
+  /// placement so that ties are broken round-robin.
+  std::atomic<size_t> NextIndex_{0};
+
+  bool isLessLoaded(size_t A, size_t B) const;
+
+public:
+  /// An idle stream moves only if its index has this many more command
+  /// lists in flight than the least loaded one.
+  static constexpr size_t RebalanceMargin = 2;
+
+  void init(size_t NumIndices);
+  /// Place a stream on the least loaded index, or on 'Affinity' modulo the
+  /// number of indices if it is not negative.
+  uint32_t acquire(int Affinity = -1);
+  void release(uint32_t Index) { NumStreams_[Index]--; }
+  /// Return a clearly less loaded index for an idle stream on 'Index' and
+  /// move the stream there, or return 'Index'.
+  uint32_t rebalance(uint32_t Index);
+  void submitted(uint32_t Index) { NumInFlight_[Index]++; }
+  void completed(uint32_t Index) { NumInFlight_[Index]--; }
+  size_t getNumStreams(uint32_t Index) const { return NumStreams_[Index]; }
+  size_t getNumInFlight(uint32_t Index) const { return NumInFlight_[Index]; }
+};
+
+/// The hardware queue index a queue submits to and its command lists in
+/// flight. Shared with the stale event monitor which may retire command
+/// lists after the queue is gone.
+struct LZQueuePlacement {
+  LZQueueGroupLoad *Load;
+  std::atomic<uint32_t> Index;
+  std::atomic<size_t> NumInFlight{0};
+
+  LZQueuePlacement(LZQueueGroupLoad *Load, uint32_t Index)
+      : Load(Load), Index(Index) {}
+  void submitted() {
+    NumInFlight++;
+    Load->submitted(Index);
+  }
+  void completed() {
+    Load->completed(Index);
+    NumInFlight--;
+  }
+};
 
-  CHIPEventLevel0 *getEvent();
+/// A submitted command list and the pool it goes back to.
+struct LZSubmittedCommandList {
+  ze_command_list_handle_t Handle;
+  std::shared_ptr<LZCommandListPool> Pool;
+  std::shared_ptr<LZQueuePlacement> Placement;
 };
 
 enum LevelZeroQueueType {
@@ -190,14 +488,23 @@ enum LevelZeroQueueType {
   Copy,
 };
 
+/**
+ * Lock order of the Level Zero queues. A thread holding one of these locks
+ * only takes the locks below it:
+ *
+ * 1. CHIPQueue::QueueMtx, which guards the immediate command list, or
+ *    CHIPQueueLevel0::BatchMtx_, which guards the open command list.
+ * 2. CHIPBackendLevel0::CommandListsMtx
+ * 3. CHIPQueueLevel0::ZeCmdQMtx_, which guards the native command queue.
+ *
+ * The locks of two queues are never held together. A queue waits for its
+ * copy queue only after releasing its own locks.
+ */
 class CHIPQueueLevel0 : public CHIPQueue {
 protected:
   ze_context_handle_t ZeCtx_;
   ze_device_handle_t ZeDev_;
 
-  // The shared memory buffer
-  void *SharedBuf_;
-
   // In case of interop queue may or may not be owned by CHIP-SPV
   // Ownership indicator helps during teardown
   bool zeCmdQOwnership_{true};
@@ -211,13 +518,116 @@ protected:
   ze_command_queue_group_properties_t QueueProperties_;
   ze_command_queue_desc_t QueueDescriptor_;
   ze_command_list_desc_t CommandListDesc_;
-  ze_command_queue_handle_t ZeCmdQ_;
+  std::atomic<ze_command_queue_handle_t> ZeCmdQ_{nullptr};
+  /// Serializes the calls on ZeCmdQ_ with DUBIOUS_LOCKS. Innermost lock.
+  std::mutex ZeCmdQMtx_;
   ze_command_list_handle_t ZeCmdList_;
 
+  /**
+   * Load-aware placement. The queue starts on the least loaded hardware
+   * queue of its group. While it has no command lists in flight it may
+   * move to a clearly less loaded one. The command queues it has used are
+   * kept until destruction. Guarded by BatchMtx_.
+   */
+  std::shared_ptr<LZQueuePlacement> Placement_;
+  std::vector<ze_command_queue_handle_t> ZeCmdQs_;
+  /// True if the queue stays on its hardware queue: it was created with
+  /// an engine affinity, wraps a native queue or has handed it out.
+  std::atomic<bool> Pinned_{false};
+  void rebalanceNoLock();
+
   void initializeCmdListImm();
 
+  /**
+   * Deferred command batching. Used only with regular command lists.
+   *
+   * While batching, consecutive commands are appended to one open command
+   * list which is submitted at synchronization points (see flush()) or when
+   * the size or latency threshold of the backend is reached. A queue which
+   * doesn't batch still defers event recordings. They are submitted with
+   * the next command or at a synchronization point.
+   */
+  std::mutex BatchMtx_;
+  /// The command list which commands are appended to. Null if none is open.
+  ze_command_list_handle_t BatchCmdList_ = nullptr;
+  size_t NumBatchedCommands_ = 0;
+  /// True if the last command in BatchCmdList_ is not a barrier. Commands in
+  /// a regular command list may run concurrently, so the next command must
+  /// be preceded by a barrier to keep the stream order.
+  bool BatchNeedsBarrier_ = false;
+  std::chrono::steady_clock::time_point BatchOpenTime_;
+  /// Events signaled by the commands in BatchCmdList_.
+  std::vector<CHIPEventLevel0 *> BatchedEvents_;
+  size_t MaxBatchSize_ = 1;
+  std::chrono::microseconds MaxBatchLatency_{0};
+  /// The regular command lists of the queue.
+  std::shared_ptr<LZCommandListPool> CmdListPool_;
+
+  /**
+   * Copy engine companion. Copies and fills are appended to a queue on the
+   * copy engine of the device, created on first use, so that they may run
+   * concurrently with the kernels of other queues. A copy waits for the
+   * last event of this queue and the next command of this queue waits for
+   * the last copy.
+   */
+  std::atomic<CHIPQueueLevel0 *> CopyQueue_{nullptr};
+  std::mutex CopyQueueMtx_;
+  /// The event of the last copy if no command of this queue waits for it
+  /// yet. Holds a reference.
+  std::atomic<CHIPEventLevel0 *> CopyDependency_{nullptr};
+  /// The copies the open command list waits for. Their references are
+  /// handed to the event tracking the command list. Guarded by BatchMtx_.
+  std::vector<CHIPEventLevel0 *> CmdListDependencies_;
+  /// Further copy queues which large copies are striped across together
+  /// with CopyQueue_. Created on first use. Guarded by CopyQueueMtx_.
+  std::vector<CHIPQueueLevel0 *> StripeQueues_;
+
+  /// Return the copy engine companion or null if copies stay on this queue.
+  CHIPQueueLevel0 *getCopyQueue();
+  /// Return the copy queues to stripe a copy of 'Size' bytes across,
+  /// 'CopyQueue' first. Empty if the copy is not striped.
+  std::vector<CHIPQueueLevel0 *> getStripeQueues(CHIPQueueLevel0 *CopyQueue,
+                                                 size_t Size);
+  /// Split a copy into chunks which are distributed round-robin across
+  /// 'Queues'. The returned event is signaled once all chunks are done.
+  CHIPEvent *enqueueStripedCopy(const std::vector<CHIPQueueLevel0 *> &Queues,
+                                void *Dst, const void *Src, size_t Size);
+  /// Make the next command appended to 'CommandList' wait for the last
+  /// copy. BatchMtx_ must be held.
+  void waitForCopyQueueNoLock(ze_command_list_handle_t CommandList);
+  /// Append a command to the copy queue after the preceding commands of
+  /// this queue. 'Append' appends the command given the command list, the
+  /// event to signal and the events to wait for. The references to
+  /// 'Dependencies' are released once the command has finished.
+  template <typename AppendFn>
+  CHIPEvent *
+  enqueueOnCopyQueue(CHIPQueueLevel0 *CopyQueue, const char *Msg,
+                     AppendFn Append,
+                     const std::vector<CHIPEventLevel0 *> &Dependencies = {});
+
+  /**
+   * @brief Close the command list and submit it to the command queue.
+   *
+   * A trailing barrier signals a tracker event once every command in the
+   * list has finished. The stale event monitor then recycles the list.
+   */
+  void submitCommandList(ze_command_list_handle_t CommandList);
+  void flushBatchNoLock();
+
 public:
   ze_command_list_handle_t getCmdList();
+
+  /// Return true if the queue defers submission of commands.
+  bool isBatching() const { return MaxBatchSize_ > 1; }
+
+  /**
+   * @brief Lock the open command list of the queue. The lock must be held
+   * from getCmdList() until executeCommandList() returns.
+   */
+  std::unique_lock<std::mutex> lockBatch() {
+    return std::unique_lock<std::mutex>(BatchMtx_);
+  }
+
   size_t getMaxMemoryFillPatternSize() {
     return QueueProperties_.maxMemoryFillPatternSize;
   }
@@ -241,18 +651,40 @@ public:
 
   virtual void finish() override;
 
+  virtual void drainPrintfBuffers() override;
+
+  /**
+   * @brief Submit the open command batch, if any.
+   */
+  virtual void flush() override;
+
+  /**
+   * @brief Stop referring to the event from the open command batch. Used when
+   * the event is destroyed after the batch failed to be submitted.
+   */
+  void forgetBatchedEvent(CHIPEventLevel0 *Event);
+
   virtual CHIPEvent *memCopyAsyncImpl(void *Dst, const void *Src,
                                       size_t Size) override;
 
   /**
-   * @brief Execute a given command list
+   * @brief Execute a given command list. If the queue is batching, the
+   * submission may be deferred.
    *
    * @param CommandList a handle to either a compute or copy command list
+   * @param SignalEvent the event signaled by the last appended command
    */
-  void executeCommandList(ze_command_list_handle_t CommandList);
+  void executeCommandList(ze_command_list_handle_t CommandList,
+                          CHIPEventLevel0 *SignalEvent);
+
+  /**
+   * @brief Append a barrier signaling a user event to the open command
+   * list. The barrier is submitted with the next command on the queue or
+   * when the event is waited on.
+   */
+  void appendEventRecord(CHIPEventLevel0 *Event);
 
   ze_command_queue_handle_t getCmdQueue() { return ZeCmdQ_; }
-  void *getSharedBufffer() { return SharedBuf_; };
 
   virtual CHIPEvent *memFillAsyncImpl(void *Dst, size_t Size,
                                       const void *Pattern,
@@ -291,26 +723,12 @@ public:
 
 class CHIPContextLevel0 : public CHIPContext {
   OpenCLFunctionInfoMap FuncInfos_;
-  std::vector<LZEventPool *> EventPools_;
+  LZEventAllocator EventAllocator_{this};
 
 public:
-  CHIPEventLevel0 *getEventFromPool() {
-
-    // go through all pools and try to get an allocated event
-    for (size_t i = 0; i < EventPools_.size(); i++) {
-      CHIPEventLevel0 *Event = EventPools_[i]->getEvent();
-      if (Event)
-        return Event;
-    }
-
-    // no events available, create new pool, get event from there and return
-    logTrace("No available events found in {} event pools. Creating a new "
-             "event pool",
-             EventPools_.size());
-    auto NewEventPool = new LZEventPool(this, EVENT_POOL_SIZE);
-    auto Event = NewEventPool->getEvent();
-    EventPools_.push_back(NewEventPool);
-    return Event;
+  CHIPEventLevel0 *getEventFromPool() { return EventAllocator_.acquire(); }
+  void returnEventToPool(CHIPEventLevel0 *Event) {
+    EventAllocator_.release(Event);
   }
 
   bool ownsZeContext = true;
@@ -369,6 +787,14 @@ public:
   ze_module_handle_t get() { return ZeModule_; }
 };
 
+/// A Level Zero kernel handle and the state last bound to it.
+struct CHIPKernelHandleLevel0 {
+  ze_kernel_handle_t ZeKernel = nullptr;
+  /// The group size last set on ZeKernel. Zeros if not set yet.
+  uint32_t GroupSize[3] = {0, 0, 0};
+  CHIPArgShadow ArgShadow;
+};
+
 class CHIPKernelLevel0 : public CHIPKernel {
 protected:
   ze_kernel_handle_t ZeKernel_;
@@ -380,14 +806,32 @@ protected:
   CHIPModuleLevel0 *Module;
   CHIPDeviceLevel0 *Device;
 
+  std::atomic<size_t> NumGroupSizeSetsSkipped_{0};
+
+  /// Kernel handles per queue. Each queue binds arguments and submits through
+  /// its own handle so launches of this kernel on different queues do not
+  /// need to be serialized. The first queue gets ZeKernel_ and the rest get
+  /// clones created from the same module.
+  std::unordered_map<const CHIPQueue *, std::unique_ptr<CHIPKernelHandleLevel0>>
+      QueueHandles_;
+  std::mutex QueueHandlesMtx_;
+
 public:
   CHIPKernelLevel0();
 
   virtual ~CHIPKernelLevel0() {
     logTrace("destroy CHIPKernelLevel0 {}", (void *)this);
+    logDebug("Kernel {}: skipped {} group size sets, {} handles", getName(),
+             NumGroupSizeSetsSkipped_.load(), QueueHandles_.size());
     // The application must not call this function from
     // simultaneous threads with the same kernel handle.
     // Done via destructor should not be called from multiple threads
+    for (auto &QueueHandle : QueueHandles_) {
+      if (QueueHandle.second->ZeKernel == ZeKernel_)
+        continue;
+      auto Result = zeKernelDestroy(QueueHandle.second->ZeKernel);
+      assert(Result == ZE_RESULT_SUCCESS && "Double free?");
+    }
     auto Result = zeKernelDestroy(ZeKernel_);
     assert(Result == ZE_RESULT_SUCCESS && "Double free?");
   }
@@ -397,6 +841,24 @@ public:
                    CHIPModuleLevel0 *Parent);
   ze_kernel_handle_t get();
 
+  /**
+   * @brief Get the kernel handle to be used for launches on the queue. The
+   * handle is created on first use.
+   *
+   * The returned handle may only be used while the queue's LaunchMtx is held.
+   */
+  CHIPKernelHandleLevel0 &getHandle(const CHIPQueue *ChipQueue);
+
+  virtual void releaseHandle(const CHIPQueue *ChipQueue) override;
+
+  /**
+   * @brief Set the group size of the kernel handle unless it is already set
+   * to the requested size.
+   */
+  void setGroupSize(CHIPKernelHandleLevel0 &Handle, uint32_t X, uint32_t Y,
+                    uint32_t Z);
+  size_t getNumGroupSizeSetsSkipped() const { return NumGroupSizeSetsSkipped_; }
+
   CHIPModuleLevel0 *getModule() override { return Module; }
   const CHIPModuleLevel0 *getModule() const override { return Module; }
   virtual hipError_t getAttributes(hipFuncAttributes *Attr) override;
@@ -448,12 +910,11 @@ class CHIPDeviceLevel0 : public CHIPDevice {
   bool CopyQueueAvailable_ = false;
   int CopyQueueGroupOrdinal_ = -1;
   int ComputeQueueGroupOrdinal_ = -1;
-  // Queues need ot be created on separate queue group indices in order to be
-  // independent from one another. Use this variable to do round-robin
-  // distribution across queues every time you create a queue.
-  std::mutex NextQueueIndexMtx_;
-  unsigned int NextCopyQueueIndex_ = 0;
-  unsigned int NextComputeQueueIndex_ = 0;
+  // Queues need to be created on separate queue group indices in order to
+  // be independent from one another. New queues go to the least loaded
+  // index of their group.
+  LZQueueGroupLoad ComputeLoad_;
+  LZQueueGroupLoad CopyLoad_;
 
   ze_command_list_desc_t CommandListComputeDesc_;
   ze_command_list_desc_t CommandListCopyDesc_;
@@ -487,10 +948,18 @@ public:
   ze_command_queue_group_properties_t getCopyQueueProps() {
     return CopyQueueProperties_;
   }
+  /// Return the descriptor of a queue on the least loaded queue index, or
+  /// on 'Affinity' if it is not negative. The queue is accounted for until
+  /// it is released from getQueueGroupLoad().
   ze_command_queue_desc_t
-  getNextComputeQueueDesc(int Priority = L0_DEFAULT_QUEUE_PRIORITY);
+  getNextComputeQueueDesc(int Priority = L0_DEFAULT_QUEUE_PRIORITY,
+                          int Affinity = -1);
   ze_command_queue_desc_t
-  getNextCopyQueueDesc(int Priority = L0_DEFAULT_QUEUE_PRIORITY);
+  getNextCopyQueueDesc(int Priority = L0_DEFAULT_QUEUE_PRIORITY,
+                       int Affinity = -1);
+  LZQueueGroupLoad &getQueueGroupLoad(LevelZeroQueueType Type) {
+    return Type == LevelZeroQueueType::Copy ? CopyLoad_ : ComputeLoad_;
+  }
 
   static CHIPDeviceLevel0 *create(ze_device_handle_t ZeDev,
                                   CHIPContextLevel0 *ChipCtx, int Idx);
@@ -500,6 +969,8 @@ public:
 
   virtual void resetImpl() override;
 
+  virtual void waitForEvents(const std::vector<CHIPEvent *> &Events) override;
+
   virtual CHIPQueue *createQueue(CHIPQueueFlags Flags, int Priority) override;
   virtual CHIPQueue *createQueue(const uintptr_t *NativeHandles,
                                  int NumHandles) override;
@@ -533,7 +1004,27 @@ public:
   virtual void uninitialize() override;
   std::mutex CommandListsMtx;
 
-  std::map<CHIPEventLevel0 *, ze_command_list_handle_t> EventCommandListMap;
+  /// Max number of commands a non-immediate queue batches into one command
+  /// list before submitting it. 1 disables batching. Set by
+  /// CHIP_L0_BATCH_SIZE.
+  size_t MaxBatchSize = 1;
+  /// Max age of a command batch before it is submitted on the next enqueue.
+  /// Set by CHIP_L0_BATCH_LATENCY_US.
+  std::chrono::microseconds MaxBatchLatency{100};
+  /// Max number of free command lists a queue keeps for reuse. Set by
+  /// CHIP_L0_CMD_LIST_POOL_SIZE.
+  size_t MaxCommandListPoolSize = 64;
+  /// Copies larger than this many bytes are split into chunks of this size
+  /// which are striped across the copy engines. 0 disables striping. Set by
+  /// CHIP_L0_COPY_CHUNK_SIZE.
+  size_t CopyChunkSize = 16 << 20;
+  /// Max number of copy engines a copy is striped across. 0 uses all the
+  /// engines of the copy queue group. Set by CHIP_L0_COPY_ENGINES.
+  size_t MaxCopyEngines = 0;
+
+  /// The submitted command lists keyed by the event of their trailing
+  /// barrier. Guarded by CommandListsMtx.
+  std::map<CHIPEventLevel0 *, LZSubmittedCommandList> EventCommandListMap;
 
   virtual void initializeImpl(std::string CHIPPlatformStr,
                               std::string CHIPDeviceTypeStr,
@@ -578,6 +1069,13 @@ public:
   virtual hipEvent_t getHipEvent(void *NativeEvent) override;
   virtual void *getNativeEvent(hipEvent_t HipEvent) override;
 
+  /// Null before the monitor is started.
+  CHIPStaleEventMonitorLevel0 *getStaleEventMonitor() {
+    return (CHIPStaleEventMonitorLevel0 *)StaleEventMonitor_;
+  }
+  CHIPCallbackEventMonitorLevel0 *getCallbackEventMonitor() {
+    return (CHIPCallbackEventMonitorLevel0 *)CallbackEventMonitor_;
+  }
 }; // CHIPBackendLevel0
 
 #endif
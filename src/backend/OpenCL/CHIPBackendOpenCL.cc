@@ -214,10 +214,12 @@ static void memCopyToImage(cl_command_queue CmdQ, cl_mem Image,
   CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
 }
 
-static void CL_CALLBACK releaseSpillBufferCallback(cl_event Event,
-                                                   cl_int CommandExecStatus,
-                                                   void *UserData) {
-  delete reinterpret_cast<std::shared_ptr<CHIPArgSpillBuffer> *>(UserData);
+static void CL_CALLBACK runEventActionCallback(cl_event Event,
+                                               cl_int CommandExecStatus,
+                                               void *UserData) {
+  std::unique_ptr<CHIPEvent::ActionFn> Action(
+      reinterpret_cast<CHIPEvent::ActionFn *>(UserData));
+  (*Action)();
 }
 
 // CHIPCallbackDataLevel0
@@ -254,6 +256,7 @@ CHIPDeviceOpenCL::createTexture(const hipResourceDesc *ResDesc,
 
   bool NormalizedFloat = TexDesc->readMode == hipReadModeNormalizedFloat;
   auto *Q = (CHIPQueueOpenCL *)getDefaultQueue();
+  Q->waitForSubmissions();
 
   cl_context CLCtx = ((CHIPContextOpenCL *)getContext())->get()->get();
   cl_sampler Sampler = createSampler(CLCtx, *ResDesc, *TexDesc);
@@ -274,7 +277,7 @@ CHIPDeviceOpenCL::createTexture(const hipResourceDesc *ResDesc,
     logTrace("Created texture: {}", (void *)Tex.get());
 
     CHIPRegionDesc SrcRegion = CHIPRegionDesc::from(*Array);
-    memCopyToImage(Q->get()->get(), Image, Array->data, SrcRegion);
+    memCopyToImage(Q->orderAfterCopies(), Image, Array->data, SrcRegion);
 
     return Tex.release();
   }
@@ -292,7 +295,7 @@ CHIPDeviceOpenCL::createTexture(const hipResourceDesc *ResDesc,
 
     // Copy data to image.
     auto SrcDesc = CHIPRegionDesc::get1DRegion(Width, TexelByteSize);
-    memCopyToImage(Q->get()->get(), Image, Res.devPtr, SrcDesc);
+    memCopyToImage(Q->orderAfterCopies(), Image, Res.devPtr, SrcDesc);
 
     return Tex.release();
   }
@@ -309,7 +312,7 @@ CHIPDeviceOpenCL::createTexture(const hipResourceDesc *ResDesc,
 
     // Copy data to image.
     auto SrcDesc = CHIPRegionDesc::from(*ResDesc);
-    memCopyToImage(Q->get()->get(), Image, Res.devPtr, SrcDesc);
+    memCopyToImage(Q->orderAfterCopies(), Image, Res.devPtr, SrcDesc);
 
     return Tex.release();
   }
@@ -466,6 +469,33 @@ void CHIPDeviceOpenCL::populateDevicePropertiesImpl() {
 }
 
 void CHIPDeviceOpenCL::resetImpl() { UNIMPLEMENTED(); }
+
+void CHIPDeviceOpenCL::waitForEvents(const std::vector<CHIPEvent *> &Events) {
+  std::vector<cl_event> ClEvents;
+  for (auto *Event : Events)
+    if (auto ClEvent = ((CHIPEventOpenCL *)Event)->getNativeRef())
+      ClEvents.push_back(ClEvent);
+  if (ClEvents.empty())
+    return;
+
+  synchronize(
+      [&]() {
+        for (auto ClEvent : ClEvents) {
+          cl_int ExecStatus;
+          auto Status =
+              clGetEventInfo(ClEvent, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                             sizeof(ExecStatus), &ExecStatus, nullptr);
+          CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+          if (ExecStatus > CL_COMPLETE)
+            return false;
+        }
+        return true;
+      },
+      [&]() {
+        auto Status = clWaitForEvents(ClEvents.size(), ClEvents.data());
+        CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+      });
+}
 // CHIPEventOpenCL
 // ************************************************************************
 
@@ -487,8 +517,9 @@ uint64_t CHIPEventOpenCL::getFinishTime() {
                                    sizeof(Ret), &Ret, NULL);
 
   if (Status != CL_SUCCESS) {
+    cl_int ExecStatus;
     auto Status = clGetEventInfo(ClEvent, CL_EVENT_COMMAND_EXECUTION_STATUS,
-                                 sizeof(int), &EventStatus_, NULL);
+                                 sizeof(ExecStatus), &ExecStatus, NULL);
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
   }
   // CHIPERR_CHECK_LOG_AND_THROW(status, CL_SUCCESS, hipErrorTbd,
@@ -520,7 +551,22 @@ CHIPEventOpenCL *CHIPBackendOpenCL::createCHIPEvent(CHIPContext *ChipCtx,
 void CHIPEventOpenCL::recordStream(CHIPQueue *ChipQueue) {
   logTrace("CHIPEvent::recordStream()");
   auto MarkerEvent = ChipQueue->enqueueMarker();
-  this->takeOver(MarkerEvent);
+  if (Flags_.isDisableTiming()) {
+    this->takeOver(MarkerEvent);
+  } else {
+    // The queue is not profiled. Time the event with a marker on the
+    // profiling queue which completes when the stream reaches the marker.
+    auto *Q = (CHIPQueueOpenCL *)ChipQueue;
+    cl_event TimingEvent = Q->enqueueTimingMarker(
+        ((CHIPEventOpenCL *)MarkerEvent)->getNativeRef());
+    LOCK(EventMtx); // CHIPEventOpenCL::ClEvent
+    CHIPEvent::decreaseRefCount("recordStream");
+    clReleaseEvent(this->ClEvent);
+    this->ClEvent = TimingEvent;
+    this->Msg = "recordStream";
+    // The reference of the enqueue is handed over to this event.
+    CHIPEvent::increaseRefCount("recordStream");
+  }
 
   this->EventStatus_ = EVENT_STATUS_RECORDING;
   return;
@@ -528,28 +574,50 @@ void CHIPEventOpenCL::recordStream(CHIPQueue *ChipQueue) {
 
 void CHIPEventOpenCL::takeOver(CHIPEvent *OtherIn) {
   logTrace("CHIPEventOpenCL::takeOver");
-  decreaseRefCount("takeOver");
-  {
-    auto *Other = (CHIPEventOpenCL *)OtherIn;
-    LOCK(EventMtx); // CHIPEvent::Refc_
-    this->ClEvent = Other->ClEvent;
-    this->Refc_ = Other->Refc_;
-    this->Msg = Other->Msg;
-  }
-  increaseRefCount("takeOver");
+  auto *Other = (CHIPEventOpenCL *)OtherIn;
+  // The native event is replaced under the lock the native retains and
+  // releases take, so each of them applies to the event it was meant for.
+  LOCK(EventMtx); // CHIPEventOpenCL::ClEvent
+  CHIPEvent::decreaseRefCount("takeOver");
+  clReleaseEvent(this->ClEvent);
+  this->ClEvent = Other->ClEvent;
+  this->Msg = Other->Msg;
+  clRetainEvent(this->ClEvent);
+  CHIPEvent::increaseRefCount("takeOver");
 }
 
 bool CHIPEventOpenCL::wait() {
   logTrace("CHIPEventOpenCL::wait()");
 
+  if (isFinished())
+    return true;
   if (EventStatus_ != EVENT_STATUS_RECORDING) {
     logWarn("Called wait() on an event that isn't active.");
     return false;
   }
 
-  auto Status = clWaitForEvents(1, &ClEvent);
-
+  // Make sure the command gets submitted while polling.
+  cl_command_queue Queue;
+  auto Status = clGetEventInfo(ClEvent, CL_EVENT_COMMAND_QUEUE,
+                               sizeof(Queue), &Queue, nullptr);
   CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  if (Queue)
+    clFlush(Queue);
+
+  ChipContext_->getDevice()->synchronize(
+      [&]() {
+        cl_int ExecStatus;
+        auto Status =
+            clGetEventInfo(ClEvent, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                           sizeof(ExecStatus), &ExecStatus, nullptr);
+        CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+        return ExecStatus <= CL_COMPLETE;
+      },
+      [&]() {
+        auto Status = clWaitForEvents(1, &ClEvent);
+        CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+      });
+  setRecorded();
   return true;
 }
 
@@ -568,7 +636,7 @@ bool CHIPEventOpenCL::updateFinishStatus(bool ThrowErrorIfNotReady) {
   }
 
   if (UpdatedStatus <= CL_COMPLETE)
-    EventStatus_ = EVENT_STATUS_RECORDED;
+    setRecorded();
 
   return true;
 }
@@ -618,32 +686,36 @@ float CHIPEventOpenCL::getElapsedTime(CHIPEvent *OtherIn) {
 
 void CHIPEventOpenCL::hostSignal() { UNIMPLEMENTED(); }
 
-void CHIPEventOpenCL::increaseRefCount(std::string Reason) {
-  LOCK(EventMtx); // CHIPEvent::Refc_
-  auto status = clRetainEvent(this->ClEvent);
-  if (!UserEvent_)
-    assert(status == 0);
-  // logDebug("CHIPEventOpenCL::increaseRefCount() {} {} refc {}->{} REASON:
-  // {}",
-  //          (void *)this, Msg.c_str(), *Refc_, *Refc_ + 1, Reason);
-  (*Refc_)++;
-  assert(*Refc_ = getRefCount() - 1);
-  // logDebug("CHIPEventOpenCL::increaseRefCount() {} OpenCL RefCount: {}",
-  //          (void *)this, getRefCount());
-}
-
-void CHIPEventOpenCL::decreaseRefCount(std::string Reason) {
-  LOCK(EventMtx); // CHIPEvent::Refc_
-  // logDebug("CHIPEventOpenCL::decreaseRefCount() {} OpenCL RefCount: {}",
-  //          (void *)this, getRefCount());
-  // logDebug("CHIPEventOpenCL::decreaseRefCount() {} {} refc {}->{} REASON:
-  // {}",
-  //          (void *)this, Msg.c_str(), *Refc_, *Refc_ - 1, Reason);
-  if (*Refc_ > 0) {
-    (*Refc_)--;
-  } else {
-    logError("CHIPEvent::decreaseRefCount() called when refc == 0");
+void CHIPEventOpenCL::addAction(ActionFn Action) {
+  cl_event Native;
+  {
+    LOCK(EventMtx); // CHIPEventOpenCL::ClEvent
+    Native = ClEvent;
+    clRetainEvent(Native);
   }
+  // The OpenCL runtime runs the action as soon as the event completes,
+  // possibly right away in this thread.
+  auto *CBData = new ActionFn(std::move(Action));
+  auto Status = clSetEventCallback(Native, CL_COMPLETE,
+                                   runEventActionCallback, CBData);
+  clReleaseEvent(Native);
+  if (Status != CL_SUCCESS) {
+    delete CBData;
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  }
+}
+
+void CHIPEventOpenCL::increaseRefCount(const char *Reason) {
+  LOCK(EventMtx); // CHIPEventOpenCL::ClEvent
+  auto Status = clRetainEvent(this->ClEvent);
+  if (!UserEvent_)
+    assert(Status == 0);
+  CHIPEvent::increaseRefCount(Reason);
+}
+
+void CHIPEventOpenCL::decreaseRefCount(const char *Reason) {
+  LOCK(EventMtx); // CHIPEventOpenCL::ClEvent
+  CHIPEvent::decreaseRefCount(Reason);
   clReleaseEvent(this->ClEvent);
 }
 
@@ -731,6 +803,39 @@ SPVFuncInfo *CHIPKernelOpenCL::getFuncInfo() const { return FuncInfo_; }
 std::string CHIPKernelOpenCL::getName() { return Name_; }
 cl::Kernel *CHIPKernelOpenCL::get() { return &OclKernel_; }
 
+CHIPKernelHandleOpenCL &
+CHIPKernelOpenCL::getHandle(const CHIPQueue *ChipQueue) {
+  LOCK(QueueHandlesMtx_); // CHIPKernelOpenCL::QueueHandles_
+  auto &Handle = QueueHandles_[ChipQueue];
+  if (Handle)
+    return *Handle;
+
+  Handle = std::make_unique<CHIPKernelHandleOpenCL>();
+  Handle->ArgShadow = CHIPArgShadow(getArgPlan());
+  if (QueueHandles_.size() == 1) {
+    Handle->Kernel = OclKernel_;
+    return *Handle;
+  }
+
+  int Err = CL_SUCCESS;
+  cl_kernel Clone = ::clCloneKernel(OclKernel_.get(), &Err);
+  if (Err != CL_SUCCESS)
+    QueueHandles_.erase(ChipQueue);
+  CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
+                              "clCloneKernel failed");
+  Handle->Kernel = cl::Kernel(Clone);
+  logTrace("Created kernel clone {} of {} for queue {}", (void *)Clone,
+           Name_, (void *)ChipQueue);
+  return *Handle;
+}
+
+void CHIPKernelOpenCL::releaseHandle(const CHIPQueue *ChipQueue) {
+  LOCK(QueueHandlesMtx_); // CHIPKernelOpenCL::QueueHandles_
+  // The clone is released by cl::Kernel once the queue's commands using it
+  // no longer need it.
+  QueueHandles_.erase(ChipQueue);
+}
+
 hipError_t CHIPKernelOpenCL::getAttributes(hipFuncAttributes *Attr) {
 
   Attr->binaryVersion = 10;
@@ -827,6 +932,8 @@ struct HipStreamCallbackData {
   hipError_t Status;
   void *UserData;
   hipStreamCallback_t Callback;
+  /// User event which the commands enqueued after the callback wait for.
+  cl_event CallbackDone;
 };
 
 void CL_CALLBACK pfn_notify(cl_event Event, cl_int CommandExecStatus,
@@ -834,9 +941,10 @@ void CL_CALLBACK pfn_notify(cl_event Event, cl_int CommandExecStatus,
   HipStreamCallbackData *Cbo = (HipStreamCallbackData *)(UserData);
   if (Cbo == nullptr)
     return;
-  if (Cbo->Callback == nullptr)
-    return;
-  Cbo->Callback(Cbo->Stream, Cbo->Status, Cbo->UserData);
+  if (Cbo->Callback)
+    Cbo->Callback(Cbo->Stream, Cbo->Status, Cbo->UserData);
+  clSetUserEventStatus(Cbo->CallbackDone, CL_COMPLETE);
+  clReleaseEvent(Cbo->CallbackDone);
   delete Cbo;
 }
 
@@ -850,12 +958,12 @@ void CHIPQueueOpenCL::MemMap(AllocationInfo *AllocInfo,
   if (Type == CHIPQueue::MEM_MAP_TYPE::HOST_READ) {
     logDebug("CHIPQueueOpenCL::MemMap HOST_READ");
     Status =
-        clEnqueueSVMMap(ClQueue_->get(), CL_TRUE, CL_MAP_READ,
+        clEnqueueSVMMap(orderAfterCopies(), CL_TRUE, CL_MAP_READ,
                         AllocInfo->HostPtr, AllocInfo->Size, 0, NULL, NULL);
   } else if (Type == CHIPQueue::MEM_MAP_TYPE::HOST_WRITE) {
     logDebug("CHIPQueueOpenCL::MemMap HOST_WRITE");
     Status =
-        clEnqueueSVMMap(ClQueue_->get(), CL_TRUE, CL_MAP_WRITE,
+        clEnqueueSVMMap(orderAfterCopies(), CL_TRUE, CL_MAP_WRITE,
                         AllocInfo->HostPtr, AllocInfo->Size, 0, NULL, NULL);
   } else {
     assert(0 && "Invalid MemMap Type");
@@ -871,7 +979,7 @@ void CHIPQueueOpenCL::MemUnmap(AllocationInfo *AllocInfo) {
   logDebug("CHIPQueueOpenCL::MemUnmap");
 
   auto Status =
-      clEnqueueSVMUnmap(ClQueue_->get(), AllocInfo->HostPtr, 0, NULL, NULL);
+      clEnqueueSVMUnmap(orderAfterCopies(), AllocInfo->HostPtr, 0, NULL, NULL);
   assert(Status == CL_SUCCESS);
 }
 
@@ -885,17 +993,33 @@ void CHIPQueueOpenCL::addCallback(hipStreamCallback_t Callback,
     Ev = (CHIPEventOpenCL *)enqueueMarker();
   }
 
-  HipStreamCallbackData *Cb =
-      new HipStreamCallbackData{this, hipSuccess, UserData, Callback};
-
-  auto Status =
-      clSetEventCallback(Ev->getNativeRef(), CL_COMPLETE, pfn_notify, Cb);
+  cl_int Status;
+  cl_context ClContext = ((CHIPContextOpenCL *)ChipContext_)->get()->get();
+  cl_event CallbackDone = clCreateUserEvent(ClContext, &Status);
   CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
 
-  // enqueue barrier with no dependencies (all further enqueues will wait for
-  // this one to finish)
+  HipStreamCallbackData *Cb = new HipStreamCallbackData{
+      this, hipSuccess, UserData, Callback, CallbackDone};
+
+  // The OpenCL runtime invokes the callback as soon as the event completes.
+  Status = clSetEventCallback(Ev->getNativeRef(), CL_COMPLETE, pfn_notify, Cb);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
 
-  auto CallbackCompleted = enqueueBarrier(nullptr);
+  // All further enqueues wait for the callback to complete.
+  CHIPEventOpenCL *CallbackCompleted =
+      (CHIPEventOpenCL *)Backend->createCHIPEvent(ChipContext_);
+  {
+    cl_command_queue Queue = orderAfterCopies();
+#ifdef DUBIOUS_LOCKS
+    LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
+#endif
+    Status = clEnqueueBarrierWithWaitList(Queue, 1, &CallbackDone,
+                                          CallbackCompleted->getNativePtr());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  }
+  CallbackCompleted->Msg = "callbackCompleted";
+  updateLastEvent(CallbackCompleted);
+  CallbackCompleted->track();
   return;
 };
 
@@ -903,13 +1027,14 @@ CHIPEvent *CHIPQueueOpenCL::enqueueMarkerImpl() {
   CHIPEventOpenCL *MarkerEvent =
       (CHIPEventOpenCL *)Backend->createCHIPEvent(ChipContext_);
   auto Status =
-      clEnqueueMarker(this->get()->get(), MarkerEvent->getNativePtr());
+      clEnqueueMarker(orderAfterCopies(), MarkerEvent->getNativePtr());
   CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
   MarkerEvent->Msg = "marker";
   return MarkerEvent;
 }
 
 CHIPEventOpenCL *CHIPQueueOpenCL::getLastEvent() {
+  waitForSubmissions();
   LOCK(LastEventMtx); // CHIPQueue::LastEvent_
   return (CHIPEventOpenCL *)LastEvent_;
 }
@@ -924,6 +1049,7 @@ CHIPEvent *CHIPQueueOpenCL::launchImpl(CHIPExecItem *ExecItem) {
   logTrace("Launching Kernel {}", Kernel->getName());
 
   ChipOclExecItem->setupAllArgs();
+  cl_kernel ClKernel = Kernel->getHandle(this).Kernel.get();
 
   dim3 GridDim = ChipOclExecItem->getGrid();
   dim3 BlockDim = ChipOclExecItem->getBlock();
@@ -937,28 +1063,17 @@ CHIPEvent *CHIPQueueOpenCL::launchImpl(CHIPExecItem *ExecItem) {
   logTrace("Launch GLOBAL: {} {} {}", Global[0], Global[1], Global[2]);
 
   logTrace("Launch LOCAL: {} {} {}", Local[0], Local[1], Local[2]);
+  cl_command_queue Queue = orderAfterCopies();
+  cl_int Status;
+  {
 #ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockOpenCL)
+    LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
 #endif
-  auto Status = clEnqueueNDRangeKernel(ClQueue_->get(), Kernel->get()->get(),
-                                       NumDims, GlobalOffset, Global, Local, 0,
-                                       nullptr, LaunchEvent->getNativePtr());
-  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
-
-  if (std::shared_ptr<CHIPArgSpillBuffer> SpillBuf =
-          ExecItem->getArgSpillBuffer()) {
-    // Use an event call back to prolong the lifetime of the spill buffer
-    // in case the exec item gets destroyed before the kernel
-    // is launched/completed (may happen when called from
-    // CHIPQueue::launchKernel()).
-    auto *CBData = new decltype(SpillBuf)(SpillBuf);
-    Status = clSetEventCallback(LaunchEvent->getNativeRef(), CL_COMPLETE,
-                                releaseSpillBufferCallback, CBData);
-    if (Status != CL_SUCCESS) {
-      delete CBData;
-      CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
-    }
+    Status = clEnqueueNDRangeKernel(Queue, ClKernel, NumDims, GlobalOffset,
+                                    Global, Local, 0, nullptr,
+                                    LaunchEvent->getNativePtr());
   }
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
 
   LaunchEvent->Msg = "KernelLaunch";
   return LaunchEvent;
@@ -966,7 +1081,9 @@ CHIPEvent *CHIPQueueOpenCL::launchImpl(CHIPExecItem *ExecItem) {
 
 CHIPQueueOpenCL::CHIPQueueOpenCL(CHIPDevice *ChipDevice, int Priority,
                                  cl_command_queue Queue)
-    : CHIPQueue(ChipDevice, CHIPQueueFlags{}, Priority) {
+    : CHIPQueue(ChipDevice, CHIPQueueFlags{}, Priority),
+      // The commands of an interop queue stay on the given queue.
+      UseCopyQueue_(CHIPCopyQueue && !Queue) {
 
   cl_queue_priority_khr PrioritySelection;
   switch (Priority_) {
@@ -996,13 +1113,11 @@ CHIPQueueOpenCL::CHIPQueueOpenCL(CHIPDevice *ChipDevice, int Priority,
     cl_int Status;
     // Adding priority breaks correctness?
     // cl_queue_properties QueueProperties[] = {
-    //     CL_QUEUE_PRIORITY_KHR, PrioritySelection, CL_QUEUE_PROPERTIES,
-    //     CL_QUEUE_PROFILING_ENABLE, 0};
-    cl_queue_properties QueueProperties[] = {CL_QUEUE_PROPERTIES,
-                                             CL_QUEUE_PROFILING_ENABLE, 0};
-
+    //     CL_QUEUE_PRIORITY_KHR, PrioritySelection, 0};
+    // Profiling is not enabled as it slows down every command. Timing
+    // events are recorded via ProfilingQueue_.
     const cl_command_queue Q = clCreateCommandQueueWithProperties(
-        ClContext_->get(), ClDevice_->get(), QueueProperties, &Status);
+        ClContext_->get(), ClDevice_->get(), nullptr, &Status);
     ClQueue_ = new cl::CommandQueue(Q);
 
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS,
@@ -1012,13 +1127,128 @@ CHIPQueueOpenCL::CHIPQueueOpenCL(CHIPDevice *ChipDevice, int Priority,
 
 CHIPQueueOpenCL::~CHIPQueueOpenCL() {
   logTrace("~CHIPQueueOpenCL() {}", (void *)this);
+  detachSubmissionWorker();
+  ChipDevice_->releaseKernelHandles(this);
+  if (ProfilingQueue_)
+    clReleaseCommandQueue(ProfilingQueue_);
+  if (cl_event Dependency = CopyDependency_.exchange(nullptr))
+    clReleaseEvent(Dependency);
+  if (cl_command_queue CopyQueue = CopyQueue_.load())
+    clReleaseCommandQueue(CopyQueue);
+}
+
+cl_event CHIPQueueOpenCL::enqueueTimingMarker(cl_event Event) {
+  // The marker on the profiling queue can only complete once the stream's
+  // marker has been submitted. Waiting on the timing event flushes just the
+  // profiling queue, so submit the stream now.
+  cl_int Status = clFlush(ClQueue_->get());
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  LOCK(ProfilingQueueMtx_); // CHIPQueueOpenCL::ProfilingQueue_
+  if (!ProfilingQueue_) {
+    logTrace("Creating a profiling queue for {}", (void *)this);
+    cl::Context *ClContext = ((CHIPContextOpenCL *)ChipContext_)->get();
+    cl::Device *ClDevice = ((CHIPDeviceOpenCL *)ChipDevice_)->get();
+    cl_queue_properties QueueProperties[] = {CL_QUEUE_PROPERTIES,
+                                             CL_QUEUE_PROFILING_ENABLE, 0};
+    ProfilingQueue_ = clCreateCommandQueueWithProperties(
+        ClContext->get(), ClDevice->get(), QueueProperties, &Status);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  }
+
+  cl_event TimingEvent;
+  Status =
+      clEnqueueMarkerWithWaitList(ProfilingQueue_, 1, &Event, &TimingEvent);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  // Submit right away so the marker completes as soon as Event does.
+  Status = clFlush(ProfilingQueue_);
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  return TimingEvent;
+}
+
+cl_command_queue CHIPQueueOpenCL::getCopyQueue() {
+  if (cl_command_queue CopyQueue = CopyQueue_.load())
+    return CopyQueue;
+  if (!UseCopyQueue_)
+    return nullptr;
+
+  LOCK(CopyQueueMtx_); // CHIPQueueOpenCL::CopyQueue_
+  if (!CopyQueue_) {
+    logTrace("Creating a copy queue for {}", (void *)this);
+    cl::Context *ClContext = ((CHIPContextOpenCL *)ChipContext_)->get();
+    cl::Device *ClDevice = ((CHIPDeviceOpenCL *)ChipDevice_)->get();
+    cl_int Status;
+    cl_command_queue CopyQueue = clCreateCommandQueueWithProperties(
+        ClContext->get(), ClDevice->get(), nullptr, &Status);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+    CopyQueue_ = CopyQueue;
+  }
+  return CopyQueue_;
+}
+
+template <typename EnqueueFn>
+CHIPEvent *CHIPQueueOpenCL::enqueueOnCopyQueue(cl_command_queue CopyQueue,
+                                               EnqueueFn Enqueue) {
+  CHIPEventOpenCL *Event =
+      (CHIPEventOpenCL *)Backend->createCHIPEvent(ChipContext_);
+
+  // Wait for the preceding commands of this queue. Getting the last event
+  // flushes them so that the wait makes progress.
+  std::vector<cl_event> WaitEvents;
+  auto *Last = (CHIPEventOpenCL *)acquireLastEvent();
+  if (Last && Last->getNativeRef())
+    WaitEvents.push_back(Last->getNativeRef());
+  cl_int Status;
+  {
+#ifdef DUBIOUS_LOCKS
+    LOCK(ClCopyQueueMtx_); // CHIPQueueOpenCL::CopyQueue_
+#endif
+    Status = Enqueue(CopyQueue, WaitEvents.size(),
+                     WaitEvents.empty() ? nullptr : WaitEvents.data(),
+                     Event->getNativePtr());
+  }
+  if (Last)
+    Last->decreaseRefCount("enqueueOnCopyQueue");
+  CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorRuntimeMemory);
+
+  // The next command of this queue waits for the copy.
+  clRetainEvent(Event->getNativeRef());
+  if (cl_event Old = CopyDependency_.exchange(Event->getNativeRef()))
+    clReleaseEvent(Old);
+  return Event;
+}
+
+cl_command_queue CHIPQueueOpenCL::orderAfterCopies() {
+  if (cl_event Dependency = CopyDependency_.exchange(nullptr)) {
+    // Submit the copy so that waiting for it from ClQueue_ makes progress.
+    auto Status = clFlush(CopyQueue_.load());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+    {
+#ifdef DUBIOUS_LOCKS
+      LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
+#endif
+      Status = clEnqueueBarrierWithWaitList(ClQueue_->get(), 1, &Dependency,
+                                            nullptr);
+    }
+    clReleaseEvent(Dependency);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  }
+  return ClQueue_->get();
 }
 
 CHIPEvent *CHIPQueueOpenCL::memCopyAsyncImpl(void *Dst, const void *Src,
                                              size_t Size) {
+  logTrace("clSVMmemcpy {} -> {} / {} B\n", Src, Dst, Size);
+  cl_command_queue CopyQueue = Dst != Src ? getCopyQueue() : nullptr;
+  if (CopyQueue)
+    return enqueueOnCopyQueue(
+        CopyQueue, [&](cl_command_queue Queue, cl_uint NumWaitEvents,
+                       const cl_event *WaitEvents, cl_event *Event) {
+          return ::clEnqueueSVMMemcpy(Queue, CL_FALSE, Dst, Src, Size,
+                                      NumWaitEvents, WaitEvents, Event);
+        });
+
   CHIPEventOpenCL *Event =
       (CHIPEventOpenCL *)Backend->createCHIPEvent(ChipContext_);
-  logTrace("clSVMmemcpy {} -> {} / {} B\n", Src, Dst, Size);
   if (Dst == Src) {
     // Although ROCm API ref says that Dst and Src should not overlap,
     // HIP seems to handle Dst == Src as a special (no-operation) case.
@@ -1029,36 +1259,93 @@ CHIPEvent *CHIPQueueOpenCL::memCopyAsyncImpl(void *Dst, const void *Src,
     // like it should. To unify the behavior, let's convert the special case to
     // a maker here, so we can return an event.
     cl::Event MarkerEvent;
-    auto Status = clEnqueueMarker(ClQueue_->get(), Event->getNativePtr());
+    auto Status = clEnqueueMarker(orderAfterCopies(), Event->getNativePtr());
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
   } else {
+    cl_command_queue Queue = orderAfterCopies();
 #ifdef DUBIOUS_LOCKS
-    LOCK(Backend->DubiousLockOpenCL)
+    LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
 #endif
-    auto Status = ::clEnqueueSVMMemcpy(ClQueue_->get(), CL_FALSE, Dst, Src,
-                                       Size, 0, nullptr, Event->getNativePtr());
+    auto Status = ::clEnqueueSVMMemcpy(Queue, CL_FALSE, Dst, Src, Size, 0,
+                                       nullptr, Event->getNativePtr());
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorRuntimeMemory);
   }
   return Event;
 }
 
 void CHIPQueueOpenCL::finish() {
+  waitForSubmissions();
+  size_t Seq = Timeline_->getSubmitted();
+  // The commands of ClQueue_ complete after the copies from here on.
+  orderAfterCopies();
+  // clFinish() is thread-safe and holds no lock so that other threads can
+  // keep enqueuing to the queue meanwhile.
+  auto Finish = [&]() {
+    auto Status = ClQueue_->finish();
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  };
+  if (ChipDevice_->getScheduleFlag() == hipDeviceScheduleBlockingSync) {
+    Finish();
+    Timeline_->complete(Seq);
+    return;
+  }
+
+  // Poll a marker which completes when the preceding commands have.
+  cl_event Marker;
+  // Releases the marker on return, also if a status check below throws.
+  cl::Event MarkerOwner;
+  {
 #ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockOpenCL)
+    LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
 #endif
-  auto Status = ClQueue_->finish();
+    auto Status = clEnqueueMarkerWithWaitList(ClQueue_->get(), 0, nullptr,
+                                              &Marker);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+    MarkerOwner = cl::Event(Marker);
+    Status = clFlush(ClQueue_->get());
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  }
+  ChipDevice_->synchronize(
+      [&]() {
+        cl_int ExecStatus;
+        auto Status = clGetEventInfo(Marker, CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                     sizeof(ExecStatus), &ExecStatus, nullptr);
+        CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+        return ExecStatus <= CL_COMPLETE;
+      },
+      Finish);
+  Timeline_->complete(Seq);
+}
+
+void CHIPQueueOpenCL::flush() {
+#ifdef DUBIOUS_LOCKS
+  LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
+#endif
+  auto Status = clFlush(ClQueue_->get());
   CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  if (cl_command_queue CopyQueue = CopyQueue_.load()) {
+    Status = clFlush(CopyQueue);
+    CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
+  }
 }
 
 CHIPEvent *CHIPQueueOpenCL::memFillAsyncImpl(void *Dst, size_t Size,
                                              const void *Pattern,
                                              size_t PatternSize) {
+  logTrace("clSVMmemfill {} / {} B\n", Dst, Size);
+  if (cl_command_queue CopyQueue = getCopyQueue())
+    return enqueueOnCopyQueue(
+        CopyQueue, [&](cl_command_queue Queue, cl_uint NumWaitEvents,
+                       const cl_event *WaitEvents, cl_event *Event) {
+          return ::clEnqueueSVMMemFill(Queue, Dst, Pattern, PatternSize, Size,
+                                       NumWaitEvents, WaitEvents, Event);
+        });
+
   CHIPEventOpenCL *Event =
       (CHIPEventOpenCL *)Backend->createCHIPEvent(ChipContext_);
-  logTrace("clSVMmemfill {} / {} B\n", Dst, Size);
-  cl_event Ev = nullptr;
-  int Retval = ::clEnqueueSVMMemFill(ClQueue_->get(), Dst, Pattern, PatternSize,
-                                     Size, 0, nullptr, Event->getNativePtr());
+  int Retval = ::clEnqueueSVMMemFill(orderAfterCopies(), Dst, Pattern,
+                                     PatternSize, Size, 0, nullptr,
+                                     Event->getNativePtr());
   CHIPERR_CHECK_LOG_AND_THROW(Retval, CL_SUCCESS, hipErrorRuntimeMemory);
   return Event;
 };
@@ -1080,6 +1367,7 @@ CHIPEvent *CHIPQueueOpenCL::memCopy3DAsyncImpl(void *Dst, size_t Dpitch,
 hipError_t CHIPQueueOpenCL::getBackendHandles(uintptr_t *NativeInfo,
                                               int *NumHandles) {
   logTrace("CHIPQueueOpenCL::getBackendHandles");
+  waitForSubmissions();
   if (*NumHandles < 4) {
     logError("getBackendHandles requires space for 4 handles");
     return hipErrorInvalidValue;
@@ -1087,7 +1375,7 @@ hipError_t CHIPQueueOpenCL::getBackendHandles(uintptr_t *NativeInfo,
   *NumHandles = 4;
 
   // Get queue handler
-  NativeInfo[3] = (uintptr_t)ClQueue_->get();
+  NativeInfo[3] = (uintptr_t)orderAfterCopies();
 
   // Get context handler
   cl::Context *Ctx = ((CHIPContextOpenCL *)ChipContext_)->get();
@@ -1109,11 +1397,12 @@ CHIPEvent *CHIPQueueOpenCL::memPrefetchImpl(const void *Ptr, size_t Count) {
 
 CHIPEvent *
 CHIPQueueOpenCL::enqueueBarrierImpl(std::vector<CHIPEvent *> *EventsToWaitFor) {
-#ifdef DUBIOUS_LOCKS
-  LOCK(Backend->DubiousLockOpenCL)
-#endif
+  cl_command_queue Queue = orderAfterCopies();
   CHIPEventOpenCL *Event =
       (CHIPEventOpenCL *)Backend->createCHIPEvent(this->ChipContext_);
+#ifdef DUBIOUS_LOCKS
+  LOCK(ClQueueMtx_); // CHIPQueueOpenCL::ClQueue_
+#endif
   cl_int RefCount;
   int Status;
   Status = clGetEventInfo(Event->getNativeRef(), CL_EVENT_REFERENCE_COUNT, 4,
@@ -1127,13 +1416,13 @@ CHIPQueueOpenCL::enqueueBarrierImpl(std::vector<CHIPEvent *> *EventsToWaitFor) {
     }
     // auto Status = ClQueue_->enqueueBarrierWithWaitList(&Events, &Barrier);
     auto Status =
-        clEnqueueBarrierWithWaitList(ClQueue_->get(), Events.size(),
-                                     Events.data(), &(Event->getNativeRef()));
+        clEnqueueBarrierWithWaitList(Queue, Events.size(), Events.data(),
+                                     &(Event->getNativeRef()));
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
   } else {
     // auto Status = ClQueue_->enqueueBarrierWithWaitList(nullptr, &Barrier);
-    auto Status = clEnqueueBarrierWithWaitList(ClQueue_->get(), 0, nullptr,
-                                               Event->getNativePtr());
+    auto Status =
+        clEnqueueBarrierWithWaitList(Queue, 0, nullptr, Event->getNativePtr());
     CHIPERR_CHECK_LOG_AND_THROW(Status, CL_SUCCESS, hipErrorTbd);
   }
 
@@ -1148,94 +1437,117 @@ CHIPQueueOpenCL::enqueueBarrierImpl(std::vector<CHIPEvent *> *EventsToWaitFor) {
 cl::Kernel *CHIPExecItemOpenCL::get() { return ClKernel_; }
 
 void CHIPExecItemOpenCL::setupAllArgs() {
-  if (!ArgsSetup) {
-    ArgsSetup = true;
-  } else {
-    return;
-  }
   CHIPKernelOpenCL *Kernel = (CHIPKernelOpenCL *)getKernel();
+  auto &KernelHandle = Kernel->getHandle(ChipQueue_);
+  cl_kernel ClKernel = KernelHandle.Kernel.get();
+  CHIPArgShadow &Shadow = KernelHandle.ArgShadow;
   SPVFuncInfo *FuncInfo = Kernel->getFuncInfo();
   int Err = 0;
 
-  if (FuncInfo->hasByRefArgs()) {
-    ArgSpillBuffer_ =
-        std::make_shared<CHIPArgSpillBuffer>(ChipQueue_->getContext());
-    ArgSpillBuffer_->computeAndReserveSpace(*FuncInfo);
-  }
-
-  auto ArgVisitor = [&](const SPVFuncInfo::KernelArg &Arg) -> void {
+  // Coarse-grained SVM can't be written from the host without mapping it, so
+  // the spilled arguments are staged and uploaded.
+  if (FuncInfo->hasByRefArgs())
+    ChipQueue_->reserveArgSpillBuffer(ArgSpillBuffer_, *Kernel,
+                                      hipMemoryTypeDevice);
+
+  // Relaunches commonly bind the same values. The queue's kernel handle keeps
+  // a shadow of the bound values so the redundant clSetKernelArg* calls can
+  // be skipped.
+  assert(Args_.size() == FuncInfo->getNumClientArgs());
+  for (const SPVArgPlanEntry &Arg : Kernel->getArgPlan()) {
+    const void *ArgData =
+        Arg.isWorkgroupPtr() ? nullptr : Args_[Arg.ClientIndex];
     switch (Arg.Kind) {
     default:
       CHIPERR_LOG_AND_THROW("Internal CHIP-SPV error: Unknown argument kind",
                             hipErrorTbd);
     case SPVTypeKind::Image: {
       auto *TexObj =
-          *reinterpret_cast<const CHIPTextureOpenCL *const *>(Arg.Data);
+          *reinterpret_cast<const CHIPTextureOpenCL *const *>(ArgData);
       cl_mem Image = TexObj->getImage();
+      if (Kernel->isArgBound(Shadow, Arg.Index, sizeof(cl_mem), &Image))
+        break;
       logTrace("set image arg {} for tex {}\n", Arg.Index, (void *)TexObj);
-      Err = ::clSetKernelArg(Kernel->get()->get(), Arg.Index, sizeof(cl_mem),
+      Err = ::clSetKernelArg(ClKernel, Arg.Index, sizeof(cl_mem),
                              &Image);
       CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
                                   "clSetKernelArg failed for image argument.");
+      Kernel->recordArgBinding(Shadow, Arg.Index, sizeof(cl_mem), &Image);
       break;
     }
     case SPVTypeKind::Sampler: {
       auto *TexObj =
-          *reinterpret_cast<const CHIPTextureOpenCL *const *>(Arg.Data);
+          *reinterpret_cast<const CHIPTextureOpenCL *const *>(ArgData);
       cl_sampler Sampler = TexObj->getSampler();
+      if (Kernel->isArgBound(Shadow, Arg.Index, sizeof(cl_sampler), &Sampler))
+        break;
       logTrace("set sampler arg {} for tex {}\n", Arg.Index, (void *)TexObj);
-      Err = ::clSetKernelArg(Kernel->get()->get(), Arg.Index,
+      Err = ::clSetKernelArg(ClKernel, Arg.Index,
                              sizeof(cl_sampler), &Sampler);
       CHIPERR_CHECK_LOG_AND_THROW(
           Err, CL_SUCCESS, hipErrorTbd,
           "clSetKernelArg failed for sampler argument.");
+      Kernel->recordArgBinding(Shadow, Arg.Index, sizeof(cl_sampler), &Sampler);
       break;
     }
     case SPVTypeKind::POD: {
+      if (Kernel->isArgBound(Shadow, Arg.Index, Arg.Size, ArgData))
+        break;
       logTrace("clSetKernelArg {} SIZE {} to {}\n", Arg.Index, Arg.Size,
-               Arg.Data);
+               ArgData);
       Err =
-          ::clSetKernelArg(Kernel->get()->get(), Arg.Index, Arg.Size, Arg.Data);
+          ::clSetKernelArg(ClKernel, Arg.Index, Arg.Size, ArgData);
       CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
                                   "clSetKernelArg failed");
+      Kernel->recordArgBinding(Shadow, Arg.Index, Arg.Size, ArgData);
       break;
     }
     case SPVTypeKind::Pointer: {
       CHIPASSERT(Arg.Size == sizeof(void *));
       if (Arg.isWorkgroupPtr()) {
+        if (Kernel->isArgBound(Shadow, Arg.Index, SharedMem_, nullptr))
+          break;
         logTrace("setLocalMemSize to {}\n", SharedMem_);
-        Err = ::clSetKernelArg(Kernel->get()->get(), Arg.Index, SharedMem_,
+        Err = ::clSetKernelArg(ClKernel, Arg.Index, SharedMem_,
                                nullptr);
+        CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
+                                    "clSetKernelArg failed");
+        Kernel->recordArgBinding(Shadow, Arg.Index, SharedMem_, nullptr);
       } else {
+        if (Kernel->isArgBound(Shadow, Arg.Index, sizeof(void *), ArgData))
+          break;
         logTrace("clSetKernelArgSVMPointer {} SIZE {} to {}\n", Arg.Index,
-                 Arg.Size, Arg.Data);
+                 Arg.Size, ArgData);
         Err = ::clSetKernelArgSVMPointer(
-            Kernel->get()->get(), Arg.Index,
+            ClKernel, Arg.Index,
             // Unlike clSetKernelArg() which takes address to the argument,
             // this function takes the argument value directly.
-            *(const void **)Arg.Data);
+            *(const void **)ArgData);
+        CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
+                                    "clSetKernelArgSVMPointer failed");
+        Kernel->recordArgBinding(Shadow, Arg.Index, sizeof(void *), ArgData);
       }
-      CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
-                                  "clSetKernelArgSVMPointer failed");
       break;
     }
     case SPVTypeKind::PODByRef: {
-      auto *SpillSlot = ArgSpillBuffer_->allocate(Arg);
+      auto *SpillSlot = ArgSpillBuffer_.allocate(Arg, ArgData);
       assert(SpillSlot);
-      Err = ::clSetKernelArgSVMPointer(Kernel->get()->get(), Arg.Index,
+      if (Kernel->isArgBound(Shadow, Arg.Index, sizeof(void *), &SpillSlot))
+        break;
+      Err = ::clSetKernelArgSVMPointer(ClKernel, Arg.Index,
                                        SpillSlot);
       CHIPERR_CHECK_LOG_AND_THROW(Err, CL_SUCCESS, hipErrorTbd,
                                   "clSetKernelArgSVMPointer failed");
+      Kernel->recordArgBinding(Shadow, Arg.Index, sizeof(void *), &SpillSlot);
       break;
     }
     }
-  };
-  FuncInfo->visitKernelArgs(getArgs(), ArgVisitor);
+  }
 
-  if (FuncInfo->hasByRefArgs())
-    ChipQueue_->memCopyAsync(ArgSpillBuffer_->getDeviceBuffer(),
-                             ArgSpillBuffer_->getHostBuffer(),
-                             ArgSpillBuffer_->getSize());
+  if (FuncInfo->hasByRefArgs() && ArgSpillBuffer_.needsUpload())
+    ChipQueue_->memCopyAsync(ArgSpillBuffer_.getDeviceBuffer(),
+                             ArgSpillBuffer_.getHostBuffer(),
+                             ArgSpillBuffer_.getSize());
 
   return;
 }
@@ -101,14 +101,15 @@ public:
   bool wait() override;
   float getElapsedTime(CHIPEvent *Other) override;
   virtual void hostSignal() override;
+  virtual void addAction(ActionFn Action) override;
   virtual bool updateFinishStatus(bool ThrowErrorIfNotReady = true) override;
   cl_event *getNativePtr() { return &ClEvent; }
   cl_event &getNativeRef() { return ClEvent; }
   uint64_t getFinishTime();
   size_t getRefCount();
 
-  virtual void increaseRefCount(std::string Reason) override;
-  virtual void decreaseRefCount(std::string Reason) override;
+  virtual void increaseRefCount(const char *Reason) override;
+  virtual void decreaseRefCount(const char *Reason) override;
 };
 
 class CHIPModuleOpenCL : public CHIPModule {
@@ -178,6 +179,7 @@ public:
   virtual CHIPQueue *createQueue(CHIPQueueFlags Flags, int Priority) override;
   virtual CHIPQueue *createQueue(const uintptr_t *NativeHandles,
                                  int NumHandles) override;
+  virtual void waitForEvents(const std::vector<CHIPEvent *> &Events) override;
 
   virtual CHIPTexture *
   createTexture(const hipResourceDesc *ResDesc, const hipTextureDesc *TexDesc,
@@ -198,6 +200,37 @@ class CHIPQueueOpenCL : public CHIPQueue {
 protected:
   // Any reason to make these private/protected?
   cl::CommandQueue *ClQueue_;
+  /// With DUBIOUS_LOCKS, serialize the enqueues to ClQueue_ and to the copy
+  /// queue. They are innermost locks: no other lock is taken while one is
+  /// held and they are never held together. Commands are therefore built,
+  /// including orderAfterCopies(), before the lock is taken.
+  std::mutex ClQueueMtx_;
+  std::mutex ClCopyQueueMtx_;
+
+  /// A profiling enabled queue for timing events. Created when the first
+  /// timing event is recorded so that ClQueue_ is not profiled.
+  cl_command_queue ProfilingQueue_ = nullptr;
+  std::mutex ProfilingQueueMtx_;
+
+  /// A second in-order queue for copies and fills, created on first use,
+  /// so that they may overlap with the kernels of other queues. A copy
+  /// waits for the last event of this queue and the next command enqueued
+  /// via orderAfterCopies() waits for the last copy.
+  bool UseCopyQueue_;
+  std::atomic<cl_command_queue> CopyQueue_{nullptr};
+  std::mutex CopyQueueMtx_;
+  /// The event of the last copy if no command of ClQueue_ waits for it
+  /// yet. Retained.
+  std::atomic<cl_event> CopyDependency_{nullptr};
+
+  /// Return the copy queue or null if copies stay on ClQueue_.
+  cl_command_queue getCopyQueue();
+  /// Enqueue a command on the copy queue after the preceding commands of
+  /// this queue. 'Enqueue' enqueues the command given the queue, the
+  /// events to wait for and the event to return.
+  template <typename EnqueueFn>
+  CHIPEvent *enqueueOnCopyQueue(cl_command_queue CopyQueue,
+                                EnqueueFn Enqueue);
 
   /**
    * @brief Map memory to device.
@@ -233,9 +266,17 @@ public:
   virtual void addCallback(hipStreamCallback_t Callback,
                            void *UserData) override;
   virtual void finish() override;
+  /// Issue the enqueued commands to the device.
+  virtual void flush() override;
   virtual CHIPEvent *memCopyAsyncImpl(void *Dst, const void *Src,
                                       size_t Size) override;
   cl::CommandQueue *get();
+  /// Return the native queue after making its next command wait for the
+  /// last copy. Use it for every command enqueued on the queue.
+  cl_command_queue orderAfterCopies();
+  /// Enqueue a profiled marker which completes after \p Event. The caller
+  /// owns the returned event.
+  cl_event enqueueTimingMarker(cl_event Event);
   virtual CHIPEvent *memFillAsyncImpl(void *Dst, size_t Size,
                                       const void *Pattern,
                                       size_t PatternSize) override;
@@ -256,6 +297,12 @@ public:
   virtual CHIPEvent *memPrefetchImpl(const void *Ptr, size_t Count) override;
 };
 
+/// An OpenCL kernel object and the arguments last bound to it.
+struct CHIPKernelHandleOpenCL {
+  cl::Kernel Kernel;
+  CHIPArgShadow ArgShadow;
+};
+
 class CHIPKernelOpenCL : public CHIPKernel {
 private:
   std::string Name_;
@@ -268,6 +315,14 @@ private:
   CHIPModuleOpenCL *Module;
   CHIPDeviceOpenCL *Device;
 
+  /// Kernel objects per queue. Each queue binds arguments and enqueues
+  /// through its own kernel object so launches of this kernel on different
+  /// queues do not need to be serialized. The first queue gets OclKernel_
+  /// and the rest get clones of it.
+  std::unordered_map<const CHIPQueue *, std::unique_ptr<CHIPKernelHandleOpenCL>>
+      QueueHandles_;
+  std::mutex QueueHandlesMtx_;
+
 public:
   CHIPKernelOpenCL(const cl::Kernel &&ClKernel, CHIPDeviceOpenCL *Dev,
                    std::string HostFName, SPVFuncInfo *FuncInfo,
@@ -277,6 +332,16 @@ public:
   std::string getName();
   cl::Kernel *get();
 
+  /**
+   * @brief Get the kernel object to be used for launches on the queue. The
+   * object is created on first use.
+   *
+   * The returned handle may only be used while the queue's LaunchMtx is held.
+   */
+  CHIPKernelHandleOpenCL &getHandle(const CHIPQueue *ChipQueue);
+
+  virtual void releaseHandle(const CHIPQueue *ChipQueue) override;
+
   CHIPModuleOpenCL *getModule() override { return Module; }
   const CHIPModuleOpenCL *getModule() const override { return Module; }
   virtual hipError_t getAttributes(hipFuncAttributes *Attr) override;
@@ -293,7 +358,6 @@ public:
     // TOOD Graphs Is this safe?
     ClKernel_ = Other.ClKernel_;
     ChipKernel_ = Other.ChipKernel_;
-    this->ArgsSetup = Other.ArgsSetup;
     this->Args_ = Other.Args_;
   }
   CHIPExecItemOpenCL(dim3 GirdDim, dim3 BlockDim, size_t SharedMem,
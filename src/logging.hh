@@ -34,6 +34,15 @@ extern std::once_flag SpdlogWasSetup;
 extern void setupSpdlog();
 extern void _setupSpdlog();
 
+/// Return true if a message at 'Level' would be emitted. Use this for
+/// guarding construction of costly log messages on hot paths.
+inline bool isLogLevelEnabled(spdlog::level::level_enum Level) {
+  if (static_cast<int>(Level) < SPDLOG_ACTIVE_LEVEL)
+    return false;
+  setupSpdlog();
+  return spdlog::default_logger_raw()->should_log(Level);
+}
+
 #if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
 template <typename... TypeArgs>
 void logTrace(const char *Fmt, const TypeArgs &...Args) {
@@ -0,0 +1,27 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <cassert>
+
+#include "CHIPBackend.hh"
+
+int main() {
+  CHIPQueueFlags Default;
+  assert(Default.getEngineAffinity() == -1);
+
+  CHIPQueueFlags Pinned(hipStreamNonBlocking | hipStreamEngineAffinity(0));
+  assert(Pinned.isNonBlocking());
+  assert(Pinned.getEngineAffinity() == 0);
+
+  assert(CHIPQueueFlags(hipStreamEngineAffinity(3)).getEngineAffinity() == 3);
+  assert(CHIPQueueFlags(hipStreamEngineAffinity(254)).getEngineAffinity() ==
+         254);
+
+  // The internal queues of a stream are placed independently.
+  CHIPQueueFlags Unpinned = Pinned.withoutEngineAffinity();
+  assert(Unpinned.isNonBlocking());
+  assert(Unpinned.getEngineAffinity() == -1);
+  assert(Unpinned.getRaw() == hipStreamNonBlocking);
+
+  return 0;
+}
@@ -0,0 +1,57 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <cassert>
+
+#include "CHIPBackend.hh"
+
+// The registry never dereferences the queue pointers.
+static CHIPQueue *fakeQueue(uintptr_t I) {
+  return reinterpret_cast<CHIPQueue *>((I + 1) * 64);
+}
+
+int main() {
+  CHIPQueueRegistry Registry;
+
+  // Insert enough entries to make the table grow a few times.
+  constexpr unsigned NumQueues = 1000;
+  for (unsigned I = 0; I < NumQueues; I++)
+    assert(Registry.insert(fakeQueue(I)));
+  assert(!Registry.insert(fakeQueue(0)));
+
+  for (unsigned I = 0; I < NumQueues; I++)
+    assert(Registry.contains(fakeQueue(I)));
+  assert(!Registry.contains(fakeQueue(NumQueues)));
+  assert(!Registry.contains(nullptr));
+
+  // Erase every other entry. The rest must stay reachable after the probe
+  // sequences are compacted.
+  for (unsigned I = 0; I < NumQueues; I += 2)
+    assert(Registry.erase(fakeQueue(I)));
+  assert(!Registry.erase(fakeQueue(0)));
+  for (unsigned I = 0; I < NumQueues; I++)
+    assert(Registry.contains(fakeQueue(I)) == (I % 2 == 1));
+
+  // Lookups of a live entry must not fail while another thread inserts and
+  // erases entries.
+  std::atomic<bool> Stop{false};
+  std::thread Writer([&]() {
+    for (unsigned Round = 0; Round < 100; Round++) {
+      for (unsigned I = NumQueues; I < 2 * NumQueues; I++)
+        Registry.insert(fakeQueue(I));
+      for (unsigned I = NumQueues; I < 2 * NumQueues; I++)
+        Registry.erase(fakeQueue(I));
+    }
+    Stop = true;
+  });
+  while (!Stop)
+    for (unsigned I = 1; I < NumQueues; I += 2)
+      assert(Registry.contains(fakeQueue(I)));
+  Writer.join();
+
+  Registry.clear();
+  for (unsigned I = 0; I < 2 * NumQueues; I++)
+    assert(!Registry.contains(fakeQueue(I)));
+
+  return 0;
+}
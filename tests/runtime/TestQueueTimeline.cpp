@@ -0,0 +1,44 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+#include <cassert>
+
+#include "CHIPBackend.hh"
+
+int main() {
+  CHIPQueueTimeline Timeline;
+  assert(Timeline.isIdle());
+  assert(Timeline.isComplete(0));
+
+  size_t First = Timeline.submit();
+  size_t Second = Timeline.submit();
+  assert(Second == First + 1);
+  assert(!Timeline.isIdle());
+  assert(!Timeline.isComplete(First));
+
+  // Completing a command implies the completion of the earlier ones.
+  Timeline.complete(Second);
+  assert(Timeline.isComplete(First));
+  assert(Timeline.isIdle());
+
+  // Late reports of earlier commands must not move the timeline back.
+  Timeline.complete(First);
+  assert(Timeline.isComplete(Second));
+
+  // Completions reported out of order by several threads.
+  constexpr size_t NumCommands = 100000;
+  size_t Base = Timeline.getSubmitted();
+  for (size_t I = 0; I < NumCommands; I++)
+    Timeline.submit();
+  std::vector<std::thread> Threads;
+  for (size_t T = 0; T < 4; T++)
+    Threads.emplace_back([&, T]() {
+      for (size_t I = T + 1; I <= NumCommands; I += 4)
+        Timeline.complete(Base + I);
+    });
+  for (auto &Thread : Threads)
+    Thread.join();
+  assert(Timeline.isIdle());
+
+  return 0;
+}